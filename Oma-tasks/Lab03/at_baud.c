@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include "at_baud.h"
+
+enum {
+    BAUD_PROBE,             // AT once at each rate of the probe list
+    BAUD_RETRY,             // AT at the saved rate with all attempts of the timing
+    BAUD_SWITCH,            // AT+UART=BR, target
+    BAUD_VERIFY,            // AT at the target rate
+    BAUD_FALLBACK           // AT back at the rate that worked before the switch
+};
+
+static void at_baud_response(at_status status, const at_record *rec, void *ctx);
+
+static void at_baud_send(at_baud *b, uint8_t stage, const char *command, const char *expected,
+                         at_timing *timing) {
+    b->stage = stage;
+    at_enqueue(b->at, command, expected, timing, at_baud_response, b);
+}
+
+static void at_baud_set(at_baud *b, uint32_t baud) {
+    b->uart_baud = baud;
+    b->set_baud(baud);
+}
+
+static void at_baud_try(at_baud *b, uint8_t stage, uint32_t baud, at_timing *timing) {
+    // After AT at another rate the module may hold part of a garbled line. The line end first
+    // completes it, the error the module answers to it does not match.
+    bool resync = b->uart_baud && b->uart_baud != baud;
+    b->current = baud;
+    at_baud_set(b, baud);
+    at_baud_send(b, stage, resync ? "\r\nAT\r\n" : "AT\r\n", "+AT: OK", timing);
+}
+
+// Tries the next rate of the probe list, returns false when all have been tried
+static bool at_baud_probe_next(at_baud *b) {
+    while (b->probe_index < 3) {
+        uint32_t baud = b->probe[b->probe_index++];
+        if (baud) {
+            at_baud_try(b, BAUD_PROBE, baud, &b->probe_timing);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void at_baud_connected(at_baud *b) {
+    if (b->current == b->target) {
+        b->done(b->current, b->ctx);
+        return;
+    }
+    snprintf(b->command, sizeof(b->command), "AT+UART=BR, %lu\r\n", (unsigned long) b->target);
+    snprintf(b->expected, sizeof(b->expected), "+UART: BR, %lu", (unsigned long) b->target);
+    at_baud_send(b, BAUD_SWITCH, b->command, b->expected, b->timing);
+}
+
+static void at_baud_response(at_status status, const at_record *rec, void *ctx) {
+    at_baud *b = ctx;
+    bool ok = status == AT_STATUS_OK;
+    switch (b->stage) {
+        case BAUD_PROBE:
+            if (ok) {
+                // the timing of the rate that answered starts from the response time of the probe
+                if (b->probe_timing.samples) {
+                    at_timing_sample(b->timing, at_timing_srtt_ms(&b->probe_timing));
+                }
+                at_baud_connected(b);
+            } else if (!at_baud_probe_next(b)) {
+                at_baud_try(b, BAUD_RETRY, b->probe[0], b->timing);
+            }
+            break;
+        case BAUD_RETRY:
+            if (ok) {
+                at_baud_connected(b);
+            } else {
+                b->done(0, b->ctx);
+            }
+            break;
+        case BAUD_SWITCH:
+            if (ok) {
+                // the command and its response are complete, so nothing is in transit at the old rate
+                at_baud_set(b, b->target);
+                at_baud_send(b, BAUD_VERIFY, "AT\r\n", "+AT: OK", b->timing);
+            } else {
+                // module refused or did not answer, it is still at the current rate
+                b->done(b->current, b->ctx);
+            }
+            break;
+        case BAUD_VERIFY:
+            if (ok) {
+                b->current = b->target;
+                b->done(b->current, b->ctx);
+            } else {
+                at_baud_try(b, BAUD_FALLBACK, b->current, b->timing);
+            }
+            break;
+        case BAUD_FALLBACK:
+            b->done(ok ? b->current : 0, b->ctx);
+            break;
+    }
+}
+
+void at_baud_start(at_baud *b, at_client *at, at_timing *timing, uint32_t saved, uint32_t target,
+                   at_baud_set_fn set_baud, at_baud_done_fn done, void *ctx) {
+    b->at = at;
+    b->timing = timing;
+    at_timing_init(&b->probe_timing, AT_BAUD_PROBE_MS, AT_BAUD_PROBE_MS, AT_BAUD_PROBE_MS, 1);
+    b->target = target;
+    b->set_baud = set_baud;
+    b->done = done;
+    b->ctx = ctx;
+    b->probe[0] = saved;
+    b->probe[1] = saved != AT_BAUD_DEFAULT ? AT_BAUD_DEFAULT : 0;
+    b->probe[2] = target != saved && target != AT_BAUD_DEFAULT ? target : 0;
+    b->probe_index = 0;
+    b->uart_baud = 0;
+    at_baud_probe_next(b);
+}
@@ -0,0 +1,51 @@
+// Baud rate negotiation with the LoRa-E5 module.
+//
+// The module keeps its rate over resets, so the saved rate is tried first, then the power
+// on default and last the target in case the rate was saved but the setting was lost.
+// Each of them gets a single AT with a short timeout, a module at another rate would
+// otherwise cost the whole retry budget of the timing per rate. If none of them answers the
+// saved rate is tried again with the timing, which gives a slow module time to start.
+// Once connected at a rate below the target, the module is told to switch with
+// AT+UART=BR, <target>. It answers at the old rate and switches after the response, the
+// local UART follows and the link is verified with AT. If the verification fails both ends
+// go back to the rate that worked. A module that changes the rate only at its next reset
+// keeps answering at the old rate, so it ends up there too.
+// Everything runs on the command queue of an at_client, the result is passed to a callback.
+
+#ifndef LAB03_AT_BAUD_H
+#define LAB03_AT_BAUD_H
+
+#include <stdint.h>
+#include "at_client.h"
+
+#define AT_BAUD_DEFAULT 9600
+#define AT_BAUD_PROBE_MS 100    // AT takes about 15 ms at 9600 baud
+
+// Reconfigures the local UART
+typedef void (*at_baud_set_fn)(uint32_t baud);
+// Called with the rate the module answers at, 0 if it did not answer at any rate
+typedef void (*at_baud_done_fn)(uint32_t baud, void *ctx);
+
+typedef struct {
+    at_client *at;
+    at_baud_set_fn set_baud;
+    at_baud_done_fn done;
+    void *ctx;
+    uint32_t probe[3];      // rates to try in order, 0 when a rate repeats an earlier one
+    int probe_index;
+    uint32_t target;
+    uint32_t current;       // rate being tried or the last one that worked
+    uint32_t uart_baud;     // rate the local UART was set to, 0 before the first probe
+    uint8_t stage;
+    at_timing *timing;      // timing of AT, also used for the switch command
+    at_timing probe_timing; // one short attempt per rate of the probe list
+    char command[32];       // AT+UART=BR, <target>
+    char expected[32];
+} at_baud;
+
+// Starts negotiation on the command queue of at. saved is the rate the module answered at
+// last time, target the rate to switch to. The local UART is expected to be at saved.
+void at_baud_start(at_baud *b, at_client *at, at_timing *timing, uint32_t saved, uint32_t target,
+                   at_baud_set_fn set_baud, at_baud_done_fn done, void *ctx);
+
+#endif //LAB03_AT_BAUD_H
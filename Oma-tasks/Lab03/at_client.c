@@ -0,0 +1,131 @@
+#include <string.h>
+#include "at_client.h"
+
+void at_init(at_client *at, at_write_fn write) {
+    memset(at, 0, sizeof(*at));
+    at->write = write;
+    at_tok_init(&at->tok);
+}
+
+static void at_send_next(at_client *at) {
+    if (at->sent || at->count == 0) {
+        return;
+    }
+    at->sent = true;
+    at->deadline_set = false;
+    at->queue[at->head].attempt = 1;
+    if (at->queue[at->head].command) {
+        at->write(at->queue[at->head].command);
+    }
+}
+
+static void at_complete(at_client *at, at_status status, const at_record *rec) {
+    // remove the command before the callback so that the callback can queue more
+    at_command cmd = at->queue[at->head];
+    at->head = (at->head + 1) % AT_QUEUE_SIZE;
+    at->count--;
+    at->sent = false;
+    if (status == AT_STATUS_OK && cmd.attempt == 1 && at->deadline_set) {
+        at_timing_sample(cmd.timing, at->now_ms - cmd.sent_ms);
+    }
+    if (cmd.callback) {
+        cmd.callback(status, rec, cmd.ctx);
+    }
+    at_send_next(at);
+}
+
+// Splits the expected response to key and value prefix with the same tokenizer that handles received lines
+static void at_parse_expected(at_command *cmd) {
+    at_tokenizer tok;
+    at_record rec;
+    at_tok_init(&tok);
+    for (const char *p = cmd->expected; *p; p++) {
+        at_tok_feed(&tok, *p, &rec);
+    }
+    at_tok_feed(&tok, '\n', &rec);
+    cmd->key_hash = rec.key_hash;
+    cmd->key_len = rec.key_len;
+    // offsets are the same in the original string
+    cmd->value_prefix = cmd->expected + rec.value_offset;
+    cmd->value_prefix_len = rec.value_len;
+}
+
+static void at_set_command(at_command *cmd, const char *command, const char *expected, at_timing *timing,
+                           at_callback callback, void *ctx) {
+    cmd->command = command;
+    cmd->expected = expected;
+    cmd->timing = timing;
+    cmd->callback = callback;
+    cmd->ctx = ctx;
+    at_parse_expected(cmd);
+}
+
+bool at_enqueue(at_client *at, const char *command, const char *expected, at_timing *timing,
+                at_callback callback, void *ctx) {
+    if (at->count == AT_QUEUE_SIZE) {
+        return false;
+    }
+    at_set_command(&at->queue[(at->head + at->count) % AT_QUEUE_SIZE], command, expected, timing, callback, ctx);
+    at->count++;
+    at_send_next(at);
+    return true;
+}
+
+bool at_wait(at_client *at, const char *expected, at_timing *timing, at_callback callback, void *ctx) {
+    if (at->count == AT_QUEUE_SIZE) {
+        return false;
+    }
+    at->head = (at->head + AT_QUEUE_SIZE - 1) % AT_QUEUE_SIZE;
+    at_set_command(&at->queue[at->head], NULL, expected, timing, callback, ctx);
+    at->count++;
+    at_send_next(at);
+    return true;
+}
+
+void at_clear(at_client *at) {
+    at->count = 0;
+    at->sent = false;
+}
+
+static bool at_match(const at_command *cmd, const at_record *rec) {
+    // key is compared by hash, characters are compared only when the hash matches
+    return rec->key_len == cmd->key_len && rec->key_hash == cmd->key_hash &&
+           memcmp(rec->line + 1, cmd->expected + 1, cmd->key_len) == 0 &&
+           rec->value_len >= cmd->value_prefix_len &&
+           memcmp(rec->line + rec->value_offset, cmd->value_prefix, cmd->value_prefix_len) == 0;
+}
+
+void at_feed(at_client *at, const char *data, size_t len) {
+    at_record rec;
+    for (size_t i = 0; i < len; i++) {
+        if (at_tok_feed(&at->tok, data[i], &rec) && at->sent && at_match(&at->queue[at->head], &rec)) {
+            at_complete(at, AT_STATUS_OK, &rec);
+        }
+    }
+}
+
+int at_poll(at_client *at, uint32_t now_ms) {
+    at->now_ms = now_ms;
+    if (at->sent) {
+        at_command *cmd = &at->queue[at->head];
+        if (!at->deadline_set) {
+            cmd->sent_ms = now_ms;
+            at->deadline_ms = now_ms + at_timing_timeout_ms(cmd->timing);
+            at->deadline_set = true;
+        } else if ((int32_t)(now_ms - at->deadline_ms) >= 0) {
+            // signed difference works across the 32-bit millisecond wrap
+            at_timing_backoff(cmd->timing);
+            if (cmd->command && cmd->attempt < cmd->timing->attempts) {
+                cmd->attempt++;
+                cmd->sent_ms = now_ms;
+                at->deadline_ms = now_ms + at_timing_timeout_ms(cmd->timing);
+                at->write(cmd->command);
+            } else {
+                at_timing_reset_backoff(cmd->timing);
+                at_record rec = { .line = "" };
+                at_complete(at, AT_STATUS_TIMEOUT, &rec);
+            }
+        }
+    }
+    return at->count;
+}
@@ -0,0 +1,79 @@
+// Non-blocking AT command engine for the LoRa-E5 module.
+//
+// Commands are queued with the response that completes them and a callback. The expected
+// response is written as "+KEY: value prefix". It is split into key hash and value prefix once
+// when the command is queued and received records are matched on those (see at_tokenizer.h).
+// The module handles one command at a time, so the engine sends the first command right
+// away and each following one as soon as the previous one has completed: the next command
+// goes out from the same at_feed() call that received the response line. A command is sent
+// again when no matching line arrives before its deadline and times out after the attempts
+// of its timing (see at_timing.h). Response times are measured from the first poll
+// after the send to the last poll before the response, so the loop should poll continuously.
+// The main loop feeds received characters and polls, nothing in here sleeps. Time is passed
+// in by the caller in milliseconds.
+
+#ifndef LAB03_AT_CLIENT_H
+#define LAB03_AT_CLIENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "at_timing.h"
+#include "at_tokenizer.h"
+
+#define AT_QUEUE_SIZE 8
+
+typedef enum {
+    AT_STATUS_OK,       // matching line received
+    AT_STATUS_TIMEOUT   // no matching line after all attempts
+} at_status;
+
+// Sends a command to the module
+typedef void (*at_write_fn)(const char *command);
+// Called when a command completes. rec is the matching record, an empty line on timeout,
+// and valid only during the call. More commands can be queued from the callback.
+typedef void (*at_callback)(at_status status, const at_record *rec, void *ctx);
+
+typedef struct {
+    const char *command;    // strings are not copied and must stay valid until the command completes, NULL: wait only
+    const char *expected;
+    at_timing *timing;      // shared by commands of the same kind, updated from their responses
+    at_callback callback;
+    void *ctx;
+    // expected response split when the command is queued
+    uint32_t key_hash;
+    size_t key_len;
+    const char *value_prefix;
+    size_t value_prefix_len;
+    int attempt;            // sends so far
+    uint32_t sent_ms;
+} at_command;
+
+typedef struct {
+    at_write_fn write;
+    at_command queue[AT_QUEUE_SIZE];
+    int head;               // queue[head] is the oldest command, it is in flight when sent is set
+    int count;
+    bool sent;
+    bool deadline_set;      // deadline of a command sent from at_feed() is set by the next at_poll()
+    uint32_t deadline_ms;
+    uint32_t now_ms;        // time of the last poll
+    at_tokenizer tok;
+} at_client;
+
+void at_init(at_client *at, at_write_fn write);
+// Queues a command, sends it immediately if nothing is in flight. Returns false if the queue is full.
+bool at_enqueue(at_client *at, const char *command, const char *expected, at_timing *timing,
+                at_callback callback, void *ctx);
+// Waits for one more line of a command that answers with several, such as AT+MSGHEX. Called
+// from the callback of the command, the wait goes ahead of the rest of the queue and nothing
+// is sent. Returns false if the queue is full.
+bool at_wait(at_client *at, const char *expected, at_timing *timing, at_callback callback, void *ctx);
+// Drops all queued commands without calling their callbacks
+void at_clear(at_client *at);
+// Feeds received characters. Records that don't match the command in flight are ignored.
+void at_feed(at_client *at, const char *data, size_t len);
+// Checks the deadline of the command in flight and resends or fails it. Returns the number of commands not yet completed.
+int at_poll(at_client *at, uint32_t now_ms);
+
+#endif //LAB03_AT_CLIENT_H
@@ -0,0 +1,126 @@
+#include "at_decode.h"
+
+static int at_hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20; // lower case
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static bool at_hex_separator(char c) {
+    return c == ':' || c == '-' || c == ' ';
+}
+
+int at_decode_hex_bytes(const char *str, size_t len, uint8_t *out, size_t size) {
+    size_t count = 0;
+    int high = -1; // first digit of the byte being decoded
+    for (size_t i = 0; i < len; i++) {
+        int digit = at_hex_digit(str[i]);
+        if (digit >= 0) {
+            if (high < 0) {
+                high = digit;
+            } else {
+                if (count == size) {
+                    return -1;
+                }
+                out[count++] = (uint8_t) (high << 4 | digit);
+                high = -1;
+            }
+        } else if (!at_hex_separator(str[i]) || high >= 0) {
+            // separators are allowed only between bytes
+            return -1;
+        }
+    }
+    return high < 0 ? (int) count : -1;
+}
+
+bool at_decode_hex_u64(const char *str, size_t len, uint64_t *value) {
+    uint64_t result = 0;
+    int digits = 0;
+    for (size_t i = 0; i < len; i++) {
+        int digit = at_hex_digit(str[i]);
+        if (digit >= 0) {
+            if (digits == 16) {
+                return false;
+            }
+            result = result << 4 | (uint64_t) digit;
+            digits++;
+        } else if (!at_hex_separator(str[i]) || digits % 2) {
+            return false;
+        }
+    }
+    if (digits == 0 || digits % 2) {
+        return false;
+    }
+    *value = result;
+    return true;
+}
+
+void at_encode_hex(const uint8_t *data, size_t len, char *out) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        *out++ = digits[data[i] >> 4];
+        *out++ = digits[data[i] & 0x0f];
+    }
+    *out = '\0';
+}
+
+bool at_decode_version(const char *str, size_t len, at_version *version) {
+    uint32_t parts[3] = { 0, 0, 0 };
+    int part = 0;
+    bool digit_seen = false;
+    for (size_t i = 0; i < len; i++) {
+        char c = str[i];
+        if (c >= '0' && c <= '9') {
+            parts[part] = parts[part] * 10 + (uint32_t) (c - '0');
+            if (parts[part] > UINT16_MAX) {
+                return false;
+            }
+            digit_seen = true;
+        } else if (c == '.' && digit_seen && part < 2) {
+            part++;
+            digit_seen = false;
+        } else {
+            return false;
+        }
+    }
+    if (part != 2 || !digit_seen) {
+        return false;
+    }
+    version->major = (uint16_t) parts[0];
+    version->minor = (uint16_t) parts[1];
+    version->patch = (uint16_t) parts[2];
+    return true;
+}
+
+bool at_decode_int(const char *str, size_t len, int32_t *value) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < len && (str[i] == '-' || str[i] == '+')) {
+        negative = str[i] == '-';
+        i++;
+    }
+    if (i == len) {
+        return false;
+    }
+    // magnitude of INT32_MIN is one larger than INT32_MAX
+    uint32_t limit = negative ? (uint32_t) INT32_MAX + 1 : (uint32_t) INT32_MAX;
+    uint32_t result = 0;
+    for (; i < len; i++) {
+        char c = str[i];
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        uint32_t digit = (uint32_t) (c - '0');
+        if (result > (limit - digit) / 10) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    *value = negative ? (int32_t) (0 - result) : (int32_t) result;
+    return true;
+}
@@ -0,0 +1,32 @@
+// Decoders for values in LoRa-E5 responses.
+//
+// Each decoder reads its input once from left to right and writes the result directly,
+// the input is never modified. Input is given as pointer and length so that values can be
+// decoded in place from an at_record (see at_tokenizer.h).
+
+#ifndef LAB03_AT_DECODE_H
+#define LAB03_AT_DECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint16_t major;
+    uint16_t minor;
+    uint16_t patch;
+} at_version;
+
+// Decodes hex bytes such as "2C:F7:F1:20". Bytes may be separated by ':', '-' or spaces.
+// Returns the number of bytes written to out or -1 if the input is not valid or does not fit.
+int at_decode_hex_bytes(const char *str, size_t len, uint8_t *out, size_t size);
+// Decodes up to 8 hex bytes (same format as above) to an integer, first byte is the most significant
+bool at_decode_hex_u64(const char *str, size_t len, uint64_t *value);
+// Writes 2 * len lower case hex digits and a terminating null to out
+void at_encode_hex(const uint8_t *data, size_t len, char *out);
+// Decodes "major.minor.patch"
+bool at_decode_version(const char *str, size_t len, at_version *version);
+// Decodes a decimal integer with optional sign, fails on overflow
+bool at_decode_int(const char *str, size_t len, int32_t *value);
+
+#endif //LAB03_AT_DECODE_H
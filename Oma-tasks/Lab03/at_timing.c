@@ -0,0 +1,58 @@
+#include "at_timing.h"
+
+void at_timing_init(at_timing *timing, uint32_t initial_ms, uint32_t floor_ms, uint32_t ceiling_ms, int attempts) {
+    timing->initial_ms = initial_ms;
+    timing->floor_ms = floor_ms;
+    timing->ceiling_ms = ceiling_ms;
+    timing->attempts = attempts > 0 ? attempts : 1;
+    timing->srtt_x8 = 0;
+    timing->rttvar_x4 = 0;
+    timing->samples = 0;
+    timing->backoff = 0;
+}
+
+void at_timing_sample(at_timing *timing, uint32_t rtt_ms) {
+    if (timing->samples == 0) {
+        timing->srtt_x8 = rtt_ms << 3;
+        timing->rttvar_x4 = rtt_ms << 1; // rttvar = rtt / 2
+    } else {
+        // the scaled values absorb 1/8 and 1/4 of the error with shifts only
+        int32_t delta = (int32_t) rtt_ms - (int32_t) (timing->srtt_x8 >> 3);
+        timing->srtt_x8 += delta;
+        if (delta < 0) {
+            delta = -delta;
+        }
+        timing->rttvar_x4 += delta - (int32_t) (timing->rttvar_x4 >> 2);
+    }
+    timing->samples++;
+    timing->backoff = 0;
+}
+
+void at_timing_backoff(at_timing *timing) {
+    // the initial timeout is already the worst case, doubling it only delays failing
+    if (timing->samples && timing->backoff < AT_TIMING_MAX_BACKOFF) {
+        timing->backoff++;
+    }
+}
+
+void at_timing_reset_backoff(at_timing *timing) {
+    timing->backoff = 0;
+}
+
+uint32_t at_timing_timeout_ms(const at_timing *timing) {
+    uint32_t margin = timing->rttvar_x4 > AT_TIMING_GRANULARITY_MS ? timing->rttvar_x4 : AT_TIMING_GRANULARITY_MS;
+    uint32_t timeout = timing->samples ? (timing->srtt_x8 >> 3) + margin : timing->initial_ms;
+    if (timeout < timing->floor_ms) {
+        timeout = timing->floor_ms;
+    }
+    timeout <<= timing->backoff;
+    return timeout < timing->ceiling_ms ? timeout : timing->ceiling_ms;
+}
+
+uint32_t at_timing_srtt_ms(const at_timing *timing) {
+    return timing->srtt_x8 >> 3;
+}
+
+uint32_t at_timing_rttvar_ms(const at_timing *timing) {
+    return timing->rttvar_x4 >> 2;
+}
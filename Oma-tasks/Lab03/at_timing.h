@@ -0,0 +1,52 @@
+// Adaptive response timeouts for AT commands.
+//
+// Each kind of command has its own at_timing that learns how long the module takes to answer.
+// Round trip times are smoothed as in TCP (Jacobson/Karels, RFC 6298):
+//   srtt   = 7/8 srtt + 1/8 rtt
+//   rttvar = 3/4 rttvar + 1/4 |srtt - rtt|
+//   timeout = srtt + max(granularity, 4 rttvar), limited to floor..ceiling
+// The granularity keeps a margin for the resolution of the poll loop when responses have
+// taken the same time for a while and rttvar has dropped to 0.
+// Until the first sample the initial timeout is used for every send, so a module that
+// never answered fails after attempts x initial timeout. Once there is a sample each
+// timeout doubles the timeout (exponential backoff, still limited to the ceiling) until a
+// response gives a new sample or the command fails.
+// Only responses to the first send of a command are sampled: after a resend it is not known
+// which send the response belongs to (Karn's algorithm).
+// A fixed timeout is a timing with floor == ceiling.
+
+#ifndef LAB03_AT_TIMING_H
+#define LAB03_AT_TIMING_H
+
+#include <stdint.h>
+
+#define AT_TIMING_MAX_BACKOFF 6
+#define AT_TIMING_GRANULARITY_MS 10
+
+typedef struct {
+    // policy
+    uint32_t initial_ms;
+    uint32_t floor_ms;
+    uint32_t ceiling_ms;
+    int attempts;           // sends before the command times out
+    // estimate
+    uint32_t srtt_x8;       // smoothed round trip time, ms * 8
+    uint32_t rttvar_x4;     // round trip time variation, ms * 4
+    uint32_t samples;
+    uint8_t backoff;        // timeout is doubled this many times
+} at_timing;
+
+void at_timing_init(at_timing *timing, uint32_t initial_ms, uint32_t floor_ms, uint32_t ceiling_ms, int attempts);
+// Adds a measured round trip time and clears the backoff
+void at_timing_sample(at_timing *timing, uint32_t rtt_ms);
+// Called when a send got no response in time, doubles the next timeout if there is a sample
+void at_timing_backoff(at_timing *timing);
+// Called when a command failed after all attempts. Nothing was learned about the response
+// time, so the backoff is cleared to keep failure detection fast for the next command.
+void at_timing_reset_backoff(at_timing *timing);
+// Timeout for the next send
+uint32_t at_timing_timeout_ms(const at_timing *timing);
+uint32_t at_timing_srtt_ms(const at_timing *timing);
+uint32_t at_timing_rttvar_ms(const at_timing *timing);
+
+#endif //LAB03_AT_TIMING_H
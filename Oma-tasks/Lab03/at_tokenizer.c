@@ -0,0 +1,91 @@
+#include "at_tokenizer.h"
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+enum {
+    TOK_START,      // nothing received on this line yet
+    TOK_KEY,        // after '+', hashing the key
+    TOK_SPACE,      // after ':', skipping spaces before the value
+    TOK_VALUE,      // in the value of a record
+    TOK_TEXT        // line is not a record
+};
+
+void at_tok_init(at_tokenizer *tok) {
+    tok->len = 0;
+    tok->state = TOK_START;
+    tok->key_hash = FNV_OFFSET;
+    tok->key_len = 0;
+    tok->value_offset = 0;
+}
+
+uint32_t at_hash(const char *key, size_t len) {
+    uint32_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t) key[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static bool at_tok_key_char(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+}
+
+static bool at_tok_line_end(at_tokenizer *tok, at_record *rec) {
+    size_t len = tok->len;
+    if (len > 0 && tok->line[len - 1] == '\r') {
+        len--;
+    }
+    tok->line[len] = '\0';
+
+    bool record = tok->state == TOK_SPACE || tok->state == TOK_VALUE;
+    rec->line = tok->line;
+    rec->len = len;
+    rec->key_hash = record ? tok->key_hash : 0;
+    rec->key_len = record ? tok->key_len : 0;
+    rec->value_offset = record ? tok->value_offset : 0;
+    if (rec->value_offset > len) {
+        rec->value_offset = len;
+    }
+    rec->value_len = len - rec->value_offset;
+
+    at_tok_init(tok);
+    return len > 0;
+}
+
+bool at_tok_feed(at_tokenizer *tok, char c, at_record *rec) {
+    if (c == '\n') {
+        return at_tok_line_end(tok, rec);
+    }
+    // characters that don't fit are dropped, classification continues
+    if (tok->len < AT_LINE_SIZE - 1) {
+        tok->line[tok->len++] = c;
+    }
+
+    switch (tok->state) {
+    case TOK_START:
+        tok->state = c == '+' ? TOK_KEY : TOK_TEXT;
+        break;
+    case TOK_KEY:
+        if (c == ':' && tok->key_len > 0) {
+            tok->state = TOK_SPACE;
+            tok->value_offset = tok->len;
+        } else if (at_tok_key_char(c)) {
+            tok->key_hash = (tok->key_hash ^ (uint8_t) c) * FNV_PRIME;
+            tok->key_len++;
+        } else {
+            tok->state = TOK_TEXT;
+        }
+        break;
+    case TOK_SPACE:
+        if (c == ' ') {
+            tok->value_offset = tok->len;
+        } else {
+            tok->state = TOK_VALUE;
+        }
+        break;
+    default:
+        break;
+    }
+    return false;
+}
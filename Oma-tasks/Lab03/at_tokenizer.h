@@ -0,0 +1,42 @@
+// Streaming tokenizer for LoRa-E5 response lines.
+//
+// Characters are fed one at a time as they come out of the receive buffer. The line is
+// classified while it arrives: for a "+KEY: value" record the key is hashed character by
+// character and the start of the value is remembered, so when the line end arrives the
+// record is complete without scanning the line again. Lines that are not records are
+// reported with key_len 0 and the whole line as the value.
+
+#ifndef LAB03_AT_TOKENIZER_H
+#define LAB03_AT_TOKENIZER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AT_LINE_SIZE 128
+
+typedef struct {
+    const char *line;       // whole line without line end, valid until the next character is fed
+    size_t len;
+    uint32_t key_hash;      // at_hash() of KEY
+    size_t key_len;         // 0 if the line is not a +KEY: record
+    size_t value_offset;    // value is line + value_offset, spaces after the colon are skipped
+    size_t value_len;
+} at_record;
+
+typedef struct {
+    char line[AT_LINE_SIZE];
+    size_t len;
+    uint8_t state;
+    uint32_t key_hash;
+    size_t key_len;
+    size_t value_offset;
+} at_tokenizer;
+
+void at_tok_init(at_tokenizer *tok);
+// Feeds one character. Returns true and fills rec when a non-empty line is complete.
+bool at_tok_feed(at_tokenizer *tok, char c, at_record *rec);
+// FNV-1a hash used for record keys
+uint32_t at_hash(const char *key, size_t len);
+
+#endif //LAB03_AT_TOKENIZER_H
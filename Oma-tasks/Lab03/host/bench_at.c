@@ -0,0 +1,301 @@
+//
+// Latency and success rate of the Lab03 client against the LoRa-E5 emulator.
+//
+// usage: bench_at [sessions] [timeout_ms] [attempts]
+//   sessions    connect + identify sequences per scenario (default 200)
+//   timeout_ms  timeout of the fixed policy (default 500)
+//   attempts    connect attempts of both policies (default 5 as in main.c)
+//
+// A session is what main.c does after the button press: AT with retries, then AT+VER and
+// AT+ID=DevEui queued together. It succeeds when the DevEui is decoded correctly.
+// Each scenario is run with a fixed timeout and with the adaptive timeouts of main.c
+// (see at_timing.h), the estimate carries over from session to session as on the device.
+// The original client (sleep 500 ms, then compare the start of everything received)
+// is run on the same scenarios for comparison. Exits with 1 if the adaptive policy takes
+// longer than attempts x 500 ms to give up on a module that is not connected.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "at_client.h"
+#include "at_decode.h"
+#include "lora_emu.h"
+
+#define MAX_SAMPLES 4096
+
+typedef struct {
+    const char *name;
+    uint32_t delay_us;
+    uint32_t jitter_us;
+    double drop_rate;
+    double garbage_rate;
+    bool connected;
+} scenario;
+
+static const scenario scenarios[] = {
+    { "ideal",     2000,       0, 0.0,  0.0,  true },
+    { "jitter",    5000,   50000, 0.0,  0.0,  true },
+    { "slow",    300000,  300000, 0.0,  0.0,  true },
+    { "lossy",     5000,    5000, 0.1,  0.0,  true },
+    { "noisy",     5000,    5000, 0.0,  0.3,  true },
+    { "bad",      20000,  100000, 0.2,  0.3,  true },
+    { "unplugged",    0,       0, 0.0,  0.0,  false },
+};
+
+typedef struct {
+    const char *command;
+    uint32_t commands;
+    uint32_t sent;
+    uint32_t ok;
+    uint32_t samples;
+    uint32_t latency_ms[MAX_SAMPLES];
+    uint64_t sent_us;
+} command_stats;
+
+enum { CMD_AT, CMD_VER, CMD_ID, CMD_COUNT };
+
+static lora_emu emu;
+static uint64_t now_us;
+static at_client at;
+static command_stats stats[CMD_COUNT];
+static at_timing connect_timing;
+static at_timing id_timing;
+static bool session_done;
+static bool session_ok;
+
+// Latency is measured from the first send of a command, resends are only counted
+static void emu_send(const char *command)
+{
+    for (int i = 0; i < CMD_COUNT; i++) {
+        if (strcmp(stats[i].command, command) == 0) {
+            if (at.queue[at.head].attempt == 1) {
+                stats[i].commands++;
+                stats[i].sent_us = now_us;
+            }
+            stats[i].sent++;
+        }
+    }
+    emu_write(&emu, command, strlen(command), now_us);
+}
+
+static void record(command_stats *st, at_status status)
+{
+    if (status != AT_STATUS_OK) {
+        return;
+    }
+    st->ok++;
+    if (st->samples < MAX_SAMPLES) {
+        st->latency_ms[st->samples++] = (uint32_t) ((now_us - st->sent_us + 999) / 1000);
+    }
+}
+
+static void on_DevEui(at_status status, const at_record *rec, void *ctx)
+{
+    record(&stats[CMD_ID], status);
+    session_done = true;
+    if (status != AT_STATUS_OK) {
+        return;
+    }
+    uint8_t eui[8];
+    uint8_t expected[8];
+    const char *value = rec->line + rec->value_offset;
+    size_t skip = strlen("DevEui, ");
+    session_ok = rec->value_len > skip &&
+                 at_decode_hex_bytes(value + skip, rec->value_len - skip, eui, sizeof(eui)) == 8 &&
+                 at_decode_hex_bytes(emu_dev_eui(), strlen(emu_dev_eui()), expected, sizeof(expected)) == 8 &&
+                 memcmp(eui, expected, sizeof(eui)) == 0;
+}
+
+static void on_version(at_status status, const at_record *rec, void *ctx)
+{
+    record(&stats[CMD_VER], status);
+    if (status != AT_STATUS_OK) {
+        at_clear(&at);
+        session_done = true;
+    }
+}
+
+static void on_connect(at_status status, const at_record *rec, void *ctx)
+{
+    record(&stats[CMD_AT], status);
+    if (status != AT_STATUS_OK) {
+        session_done = true;
+        return;
+    }
+    at_enqueue(&at, "AT+VER\r\n", "+VER: ", &id_timing, on_version, NULL);
+    at_enqueue(&at, "AT+ID=DevEui\r\n", "+ID: DevEui,", &id_timing, on_DevEui, NULL);
+}
+
+// Feeds arrived characters and polls, then moves the clock to the next character or millisecond
+static void step(void)
+{
+    char buffer[64];
+    size_t n;
+    while ((n = emu_read(&emu, now_us, buffer, sizeof(buffer))) > 0) {
+        at_feed(&at, buffer, n);
+    }
+    at_poll(&at, (uint32_t) (now_us / 1000));
+    uint64_t next = emu_next_event_us(&emu);
+    uint64_t tick = (now_us / 1000 + 1) * 1000;
+    now_us = next < tick ? next : tick;
+}
+
+static uint64_t run_session(void)
+{
+    uint64_t start = now_us;
+    at_init(&at, emu_send);
+    session_done = false;
+    session_ok = false;
+    at_enqueue(&at, "AT\r\n", "+AT: OK", &connect_timing, on_connect, NULL);
+    while (!session_done) {
+        step();
+    }
+    return now_us - start;
+}
+
+// Original client: read_response() sleeps 500 ms and compares the start of everything received
+static bool legacy_command(const char *command, const char *expected, int tries)
+{
+    emu_write(&emu, command, strlen(command), now_us);
+    for (int i = 0; i < tries; i++) {
+        now_us += 500000;
+        char data[256];
+        size_t len = emu_read(&emu, now_us, data, sizeof(data) - 1);
+        data[len] = '\0';
+        if (strncmp(data, expected, strlen(expected)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t run_legacy_session(bool *ok)
+{
+    uint64_t start = now_us;
+    *ok = legacy_command("AT\r\n", "+AT: OK", 5) &&
+          legacy_command("AT+VER\r\n", "+VER: ", 5) &&
+          legacy_command("AT+ID=DevEui\r\n", "+ID: DevEui,", 5);
+    // let anything still coming drain before the next session
+    now_us += 2000000;
+    char data[256];
+    while (emu_read(&emu, now_us, data, sizeof(data)) > 0) {
+    }
+    return now_us - 2000000 - start;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(command_stats *st, int p)
+{
+    if (st->samples == 0) {
+        return 0;
+    }
+    qsort(st->latency_ms, st->samples, sizeof(uint32_t), compare_u32);
+    return st->latency_ms[(st->samples - 1) * p / 100];
+}
+
+static void configure(emu_config *config, const scenario *sc)
+{
+    emu_default_config(config);
+    config->delay_us = sc->delay_us;
+    config->jitter_us = sc->jitter_us;
+    config->drop_rate = sc->drop_rate;
+    config->garbage_rate = sc->garbage_rate;
+    config->connected = sc->connected;
+}
+
+// Runs the sessions of a scenario with the current timings and prints a row per command.
+// Returns the mean session time in ms.
+static double run_policy(const scenario *sc, uint32_t seed, const char *policy, int sessions)
+{
+    emu_config config;
+    configure(&config, sc);
+    memset(stats, 0, sizeof(stats));
+    stats[CMD_AT].command = "AT\r\n";
+    stats[CMD_VER].command = "AT+VER\r\n";
+    stats[CMD_ID].command = "AT+ID=DevEui\r\n";
+
+    emu_init(&emu, &config, seed);
+    now_us = 0;
+    int ok = 0;
+    uint64_t total_us = 0;
+    for (int i = 0; i < sessions; i++) {
+        total_us += run_session();
+        ok += session_ok;
+    }
+
+    for (int c = 0; c < CMD_COUNT; c++) {
+        command_stats *st = &stats[c];
+        char name[16];
+        snprintf(name, sizeof(name), "%.*s", (int) strcspn(st->command + 3, "\r"), st->command + 3);
+        printf("%-10s %-9s %-9s %6u %6u %6.1f %7u %7u %7u |",
+               c == 0 ? sc->name : "", c == 0 ? policy : "", c ? name : "AT",
+               st->commands, st->sent, st->commands ? 100.0 * st->ok / st->commands : 0.0,
+               percentile(st, 50), percentile(st, 90), percentile(st, 99));
+        if (c == 0) {
+            printf(" %7.1f%% %9.1f |", 100.0 * ok / sessions, total_us / 1000.0 / sessions);
+        } else {
+            printf(" %8s %9s |", "", "");
+        }
+        // estimates at the end of the run
+        const at_timing *timing = c == 0 ? &connect_timing : &id_timing;
+        if (c < 2) {
+            printf(" %5u %5u %6u", at_timing_srtt_ms(timing), at_timing_rttvar_ms(timing),
+                   at_timing_timeout_ms(timing));
+        }
+        printf("\n");
+    }
+    return total_us / 1000.0 / sessions;
+}
+
+int main(int argc, char **argv)
+{
+    int sessions = argc > 1 ? atoi(argv[1]) : 200;
+    uint32_t timeout_ms = argc > 2 ? (uint32_t) atoi(argv[2]) : 500;
+    int attempts = argc > 3 ? atoi(argv[3]) : 5;
+    int errors = 0;
+
+    printf("%d sessions per scenario, fixed timeout %u ms, %d connect attempts\n", sessions, timeout_ms, attempts);
+    printf("adaptive: initial 500 ms, 20..2000 ms, identification 2 attempts\n");
+    printf("%-10s %-9s %-9s %6s %6s %6s %7s %7s %7s | %8s %9s | %5s %5s %6s\n",
+           "scenario", "policy", "cmd", "cmds", "sent", "ok%", "p50 ms", "p90 ms", "p99 ms",
+           "session", "mean ms", "srtt", "var", "timeout");
+
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        const scenario *sc = &scenarios[s];
+        uint32_t seed = 12345 + (uint32_t) s;
+
+        at_timing_init(&connect_timing, timeout_ms, timeout_ms, timeout_ms, attempts);
+        at_timing_init(&id_timing, timeout_ms, timeout_ms, timeout_ms, 2);
+        run_policy(sc, seed, "fixed", sessions);
+
+        at_timing_init(&connect_timing, 500, 20, 2000, attempts);
+        at_timing_init(&id_timing, 500, 20, 2000, 2);
+        double adaptive_ms = run_policy(sc, seed, "adaptive", sessions);
+        // the 5 x 500 ms of the assignment, plus the poll that notices the last timeout
+        if (!sc->connected && adaptive_ms > attempts * 500.0 + 1) {
+            printf("%-10s %-9s gives up after %.1f ms, more than %d x 500 ms\n", "", "adaptive", adaptive_ms, attempts);
+            errors++;
+        }
+
+        emu_config config;
+        configure(&config, sc);
+        emu_init(&emu, &config, seed);
+        now_us = 0;
+        int legacy_ok = 0;
+        uint64_t legacy_us = 0;
+        for (int i = 0; i < sessions; i++) {
+            bool session;
+            legacy_us += run_legacy_session(&session);
+            legacy_ok += session;
+        }
+        printf("%-10s %-9s %-9s %6s %6s %6s %7s %7s %7s | %7.1f%% %9.1f |\n", "", "legacy", "", "", "", "", "", "", "",
+               100.0 * legacy_ok / sessions, legacy_us / 1000.0 / sessions);
+    }
+    return errors ? 1 : 0;
+}
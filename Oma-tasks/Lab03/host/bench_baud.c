@@ -0,0 +1,160 @@
+//
+// Baud rate negotiation of the Lab03 client against the LoRa-E5 emulator.
+//
+// usage: bench_baud [reads]
+//   reads  AT+ID reads timed at the negotiated rate (default 50)
+//
+// Each case boots the client with a saved rate against a module in a given state, runs the
+// negotiation of main.c (at_baud.h) and checks the rate both ends agree on. The module
+// state carries over to the next case where noted, as it does over a reboot of the Pico.
+// Then reading all IDs is timed at the negotiated rate. Exits with 1 if a case ends at an
+// unexpected rate or connects slower than its limit.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "at_baud.h"
+#include "at_client.h"
+#include "lora_emu.h"
+
+typedef struct {
+    const char *name;
+    uint32_t module_baud;   // module rate at the start, 0: left as the previous case ended
+    uint32_t saved;         // rate the client starts with
+    uint32_t max_baud;
+    bool baud_on_reset;
+    uint32_t expected;      // rate the negotiation should end at, 0: module unreachable
+    uint32_t max_connect_ms; // 0: no limit, the failed switch costs the retries of the timing
+} test_case;
+
+// A module at any of the probed rates answers the first probe at its rate, so a wrong saved
+// rate costs one short probe instead of all attempts at the rate.
+static const test_case cases[] = {
+    { "first boot",                 9600,   9600,   0,     false, 115200, 250 },
+    { "reboot, rate saved",         0,      115200, 0,     false, 115200, 250 },
+    { "reboot, setting lost",       0,      9600,   0,     false, 115200, 250 },
+    { "module reset to default",    9600,   115200, 0,     false, 115200, 250 },
+    { "rate applied at reset",      9600,   9600,   0,     true,  9600,   0 },
+    { "wiring limited to 57600",    9600,   9600,   57600, true,  9600,   0 },
+    // the module switches, but the link can't carry the rate: unreachable until it is reset
+    { "limited, immediate switch",  9600,   9600,   57600, false, 0,      0 },
+};
+
+static lora_emu emu;
+static uint64_t now_us;
+static at_client at;
+static at_timing timing;
+static at_baud baud;
+static bool done;
+static uint32_t result;
+static uint32_t reads_ok;
+
+static void emu_send(const char *command)
+{
+    emu_write(&emu, command, strlen(command), now_us);
+}
+
+static void set_baud(uint32_t rate)
+{
+    emu_set_client_baud(&emu, rate);
+}
+
+static void on_baud(uint32_t rate, void *ctx)
+{
+    result = rate;
+    done = true;
+}
+
+static void on_ids(at_status status, const at_record *rec, void *ctx)
+{
+    reads_ok += status == AT_STATUS_OK;
+    done = true;
+}
+
+static void step(void)
+{
+    char buffer[64];
+    size_t n;
+    while ((n = emu_read(&emu, now_us, buffer, sizeof(buffer))) > 0) {
+        at_feed(&at, buffer, n);
+    }
+    at_poll(&at, (uint32_t) (now_us / 1000));
+    uint64_t next = emu_next_event_us(&emu);
+    uint64_t tick = (now_us / 1000 + 1) * 1000;
+    now_us = next < tick ? next : tick;
+}
+
+static void run(void)
+{
+    done = false;
+    while (!done) {
+        step();
+    }
+    // let the last response line finish
+    while (emu_next_event_us(&emu) != UINT64_MAX) {
+        step();
+    }
+}
+
+// Mean time of reading all IDs, the last of the three lines completes the command
+static double time_reads(int reads)
+{
+    reads_ok = 0;
+    uint64_t start = now_us;
+    for (int i = 0; i < reads; i++) {
+        at_enqueue(&at, "AT+ID\r\n", "+ID: AppEui", &timing, on_ids, NULL);
+        run();
+    }
+    return (now_us - start) / 1000.0 / reads;
+}
+
+int main(int argc, char **argv)
+{
+    int reads = argc > 1 ? atoi(argv[1]) : 50;
+    int errors = 0;
+
+    printf("%-26s %7s %7s %8s %7s %9s %8s %10s\n",
+           "case", "module", "saved", "result", "sent", "connect", "AT+ID", "ms/AT+ID");
+    emu_config config;
+    emu_default_config(&config);
+    emu_init(&emu, &config, 1);
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const test_case *tc = &cases[i];
+        config.max_baud = tc->max_baud;
+        config.baud_on_reset = tc->baud_on_reset;
+        if (tc->module_baud) {
+            config.baud = tc->module_baud;
+            emu_init(&emu, &config, (uint32_t) i + 1);
+        } else {
+            // reboot of the Pico, the module keeps its rate
+            emu.config = config;
+            emu_reset(&emu, now_us);
+        }
+        uint32_t module_baud = emu_baud(&emu, now_us);
+        emu_set_client_baud(&emu, tc->saved);
+        at_init(&at, emu_send);
+        at_timing_init(&timing, 500, 20, 2000, 5);
+
+        uint32_t commands = emu.counters.commands;
+        uint64_t start = now_us;
+        at_baud_start(&baud, &at, &timing, tc->saved, 115200, set_baud, on_baud, NULL);
+        run();
+        double connect_ms = (now_us - start) / 1000.0;
+        commands = emu.counters.commands - commands;
+
+        bool ok = result == tc->expected;
+        if (result && emu_baud(&emu, now_us) != result) {
+            ok = false;
+        }
+        bool slow = tc->max_connect_ms && connect_ms > tc->max_connect_ms;
+        errors += !ok || slow;
+        printf("%-26s %7u %7u %8u %7u %7.0fms", tc->name, module_baud, tc->saved, result, commands, connect_ms);
+        if (result) {
+            double ms = time_reads(reads);
+            printf(" %7u%% %10.1f", reads_ok * 100 / reads, ms);
+        }
+        printf("%s%s\n", ok ? "" : "  <-- unexpected rate", slow ? "  <-- slow connect" : "");
+    }
+    printf("%s\n", errors ? "FAILED" : "all cases ended at the expected rate in time");
+    return errors ? 1 : 0;
+}
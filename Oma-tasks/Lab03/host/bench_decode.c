@@ -0,0 +1,318 @@
+//
+// Micro-benchmark for the AT value decoders.
+//
+// usage: bench_decode [iterations]
+//
+// Inputs are generated from random values, every decoder result is compared with the
+// value the input was made from. The original DevEui processing from main.c (colons
+// removed by shifting the string) is included for comparison.
+// Then a table of response lines, well-formed, truncated, over-long, without a line end or
+// with noise, is fed through the tokenizer and the decoder for each value.
+// Exits with status 1 if any decoder returned a wrong result.
+// fuzz_decode.c feeds arbitrary input through the same path.
+//
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "at_decode.h"
+#include "at_tokenizer.h"
+
+#define INPUTS 1024
+
+// Decoder run on the value of a line
+typedef enum {
+    DECODE_NONE,
+    DECODE_ID,          // label and 8 hex bytes, as decode_id() in main.c
+    DECODE_U64,
+    DECODE_VERSION,
+    DECODE_INT
+} decode_kind;
+
+typedef struct {
+    const char *name;
+    const char *input;      // fed to the tokenizer one character at a time
+    int records;            // non-empty lines completed
+    const char *key;        // key of the last line, NULL if it is not a +KEY: record
+    const char *value;      // value of the last line, the whole line if it is not a record
+    decode_kind decode;
+    const char *result;     // decoded value printed back, NULL if the decoder rejects it
+} line_case;
+
+#define EUI "2C:F7:F1:20:42:00:12:34"
+#define EUI_HEX "2cf7f12042001234"
+
+static const line_case line_cases[] = {
+    // well-formed
+    { "DevEui",             "+ID: DevEui, " EUI "\r\n",     1, "ID",  "DevEui, " EUI,       DECODE_ID,      EUI_HEX },
+    { "EUI as integer",     "+ID: " EUI "\r\n",             1, "ID",  EUI,                  DECODE_U64,     EUI_HEX },
+    { "version",            "+VER: 4.0.11\r\n",             1, "VER", "4.0.11",             DECODE_VERSION, "4.0.11" },
+    { "negative",           "+N: -2147483648\r\n",          1, "N",   "-2147483648",        DECODE_INT,     "-2147483648" },
+    { "line end only",      "+AT: OK\n",                     1, "AT",  "OK",                 DECODE_NONE,    NULL },
+    // truncated
+    { "DevEui 3 bytes",     "+ID: DevEui, 2C:F7:F1\r\n",    1, "ID",  "DevEui, 2C:F7:F1",   DECODE_ID,      NULL },
+    { "half byte",          "+ID: DevEui, 2C:F\r\n",        1, "ID",  "DevEui, 2C:F",       DECODE_ID,      NULL },
+    { "odd digits",         "+ID: 0011223\r\n",             1, "ID",  "0011223",            DECODE_U64,     NULL },
+    { "version 2 parts",    "+VER: 1.2\r\n",                1, "VER", "1.2",                DECODE_VERSION, NULL },
+    { "version ends in .",  "+VER: 1.2.\r\n",               1, "VER", "1.2.",               DECODE_VERSION, NULL },
+    { "sign only",          "+N: -\r\n",                    1, "N",   "-",                  DECODE_INT,     NULL },
+    { "no value",           "+ID:\r\n",                     1, "ID",  "",                   DECODE_ID,      NULL },
+    // over-long
+    { "DevEui 9 bytes",     "+ID: DevEui, " EUI ":88\r\n",  1, "ID",  "DevEui, " EUI ":88", DECODE_ID,      NULL },
+    { "17 digits",          "+ID: 00112233445566778\r\n",   1, "ID",  "00112233445566778",  DECODE_U64,     NULL },
+    { "version overflow",   "+VER: 1.2.70000\r\n",          1, "VER", "1.2.70000",          DECODE_VERSION, NULL },
+    { "int overflow",       "+N: 2147483648\r\n",           1, "N",   "2147483648",         DECODE_INT,     NULL },
+    // the tokenizer keeps AT_LINE_SIZE - 1 characters
+    { "line over buffer",   "+ID: DevEui, " EUI ":" EUI ":" EUI ":" EUI ":" EUI ":" EUI "\r\n", 1, "ID",
+                            "DevEui, " EUI ":" EUI ":" EUI ":" EUI ":2C:F7:F1:20:42:00:", DECODE_ID, NULL },
+    // missing line end
+    { "no line end",        "+AT: OK",                       0, NULL,  NULL,                 DECODE_NONE,    NULL },
+    { "empty lines",        "\r\n\n\r\n",                   0, NULL,  NULL,                 DECODE_NONE,    NULL },
+    { "line end lost",      "+VER: 4.0.11+AT: OK\r\n",      1, "VER", "4.0.11+AT: OK",      DECODE_VERSION, NULL },
+    { "return only",        "+AT: OK\r+VER: 4.0.11\r\n",   1, "AT",  "OK\r+VER: 4.0.11",   DECODE_NONE,    NULL },
+    // garbage
+    { "noise",              "\x80\xfe\x13+\r\n",             1, NULL,  "\x80\xfe\x13+",        DECODE_NONE,    NULL },
+    { "noise line first",   "\x01+\x02\r\n+VER: 4.0.11\r\n", 2, "VER", "4.0.11",             DECODE_VERSION, "4.0.11" },
+    { "no colon",           "+ID DevEui\r\n",               1, NULL,  "+ID DevEui",         DECODE_NONE,    NULL },
+    { "empty key",          "+: OK\r\n",                    1, NULL,  "+: OK",              DECODE_NONE,    NULL },
+    { "noise in key",       "+V\xb3R: 4.0.11\r\n",          1, NULL,  "+V\xb3R: 4.0.11",     DECODE_NONE,    NULL },
+    { "noise in value",     "+ID: DevEui, 2C:F7:\x92\x11:20:42:00:12:34\r\n", 1, "ID",
+                            "DevEui, 2C:F7:\x92\x11:20:42:00:12:34",                          DECODE_ID,      NULL },
+    { "separator in byte",  "+ID: DevEui, 2:CF\r\n",        1, "ID",  "DevEui, 2:CF",       DECODE_ID,      NULL },
+    { "not hex",            "+ID: DevEui, 2CXF\r\n",        1, "ID",  "DevEui, 2CXF",       DECODE_ID,      NULL },
+    { "double dot",         "+VER: 1..2\r\n",               1, "VER", "1..2",               DECODE_VERSION, NULL },
+    { "letter in int",      "+N: 12a\r\n",                  1, "N",   "12a",                DECODE_INT,     NULL },
+};
+
+static uint64_t wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t random_u64(void)
+{
+    return (uint64_t) rand() << 62 ^ (uint64_t) rand() << 31 ^ (uint64_t) rand();
+}
+
+// DevEui processing of the original Lab03 client, works on "+ID: DevEui, 2C:F7:..."
+static void legacy_DevEui(char DevEui[], const int DevEui_len)
+{
+    for (int strlen = 0; strlen < DevEui_len; strlen++){
+        if (DevEui[strlen] == ':'){
+            for (int i = strlen; i < DevEui_len; i++){
+                DevEui[i] = DevEui[i + 1];
+            }
+        }
+        DevEui[strlen] = tolower(DevEui[strlen]);
+    }
+    for (size_t i = 0; i < strlen("+ID: DevEui "); i++){
+        for (int j = 0; j < DevEui_len; j++){
+            DevEui[j] = DevEui[j + 1];
+        }
+    }
+}
+
+static void report(const char *name, uint64_t ns, long ops, int errors)
+{
+    printf("%-14s %8.1f ns/op %8d errors\n", name, (double) ns / ops, errors);
+}
+
+// Decodes the value of rec and prints it to result, returns false if the decoder rejects it
+static bool decode_value(decode_kind decode, const at_record *rec, char *result, size_t size)
+{
+    const char *value = rec->line + rec->value_offset;
+    size_t len = rec->value_len;
+    switch (decode) {
+        case DECODE_ID: {
+            size_t skip = strlen("DevEui,");
+            while (skip < len && value[skip] == ' ') {
+                skip++;
+            }
+            uint8_t id[8];
+            if (skip > len || at_decode_hex_bytes(value + skip, len - skip, id, sizeof(id)) != (int) sizeof(id)) {
+                return false;
+            }
+            at_encode_hex(id, sizeof(id), result);
+            return true;
+        }
+        case DECODE_U64: {
+            uint64_t u;
+            if (!at_decode_hex_u64(value, len, &u)) {
+                return false;
+            }
+            snprintf(result, size, "%016llx", (unsigned long long) u);
+            return true;
+        }
+        case DECODE_VERSION: {
+            at_version v;
+            if (!at_decode_version(value, len, &v)) {
+                return false;
+            }
+            snprintf(result, size, "%u.%u.%u", v.major, v.minor, v.patch);
+            return true;
+        }
+        case DECODE_INT: {
+            int32_t i;
+            if (!at_decode_int(value, len, &i)) {
+                return false;
+            }
+            snprintf(result, size, "%d", i);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// Feeds the input of a case to the tokenizer and checks the last line and its value
+static bool run_line_case(const line_case *tc)
+{
+    at_tokenizer tok;
+    at_record rec;
+    at_tok_init(&tok);
+    int records = 0;
+    bool is_record = false;
+    bool key_ok = false;
+    char value[AT_LINE_SIZE] = "";
+    char result[32];
+    bool decoded = false;
+    for (const char *p = tc->input; *p; p++) {
+        if (!at_tok_feed(&tok, *p, &rec)) {
+            continue;
+        }
+        // the record is valid until the next character, keep what is checked
+        records++;
+        is_record = rec.key_len > 0;
+        key_ok = tc->key && rec.key_len == strlen(tc->key) && memcmp(rec.line + 1, tc->key, rec.key_len) == 0 &&
+                 rec.key_hash == at_hash(tc->key, rec.key_len);
+        snprintf(value, sizeof(value), "%.*s", (int) rec.value_len, rec.line + rec.value_offset);
+        decoded = decode_value(tc->decode, &rec, result, sizeof(result));
+    }
+
+    bool ok = records == tc->records;
+    if (ok && records > 0) {
+        ok = (tc->key ? is_record && key_ok : !is_record) && strcmp(value, tc->value) == 0 &&
+             (tc->result ? decoded && strcmp(result, tc->result) == 0 : !decoded);
+    }
+    if (!ok) {
+        printf("line case \"%s\": %d lines, %s \"%s\", decoded %s\n", tc->name, records,
+               is_record ? "record" : "text", value, decoded ? result : "no");
+    }
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 2000;
+    static char eui_text[INPUTS][32];
+    static char line_text[INPUTS][48];
+    static char expected_hex[INPUTS][17];
+    static uint64_t eui[INPUTS];
+    static char version_text[INPUTS][20];
+    static at_version versions[INPUTS];
+    static char int_text[INPUTS][16];
+    static int32_t ints[INPUTS];
+    volatile uint64_t sink = 0;
+    int failed = 0;
+
+    srand(1);
+    for (int i = 0; i < INPUTS; i++) {
+        eui[i] = random_u64();
+        uint8_t b[8];
+        for (int j = 0; j < 8; j++) b[j] = (uint8_t) (eui[i] >> (56 - 8 * j));
+        sprintf(eui_text[i], "%02X:%02X:%02X:%02X:%02X:%02X:%02X:%02X", b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7]);
+        sprintf(line_text[i], "+ID: DevEui, %s", eui_text[i]);
+        sprintf(expected_hex[i], "%016llx", (unsigned long long) eui[i]);
+        versions[i].major = rand() % 10;
+        versions[i].minor = rand() % 100;
+        versions[i].patch = rand() % 1000;
+        sprintf(version_text[i], "%u.%u.%u", versions[i].major, versions[i].minor, versions[i].patch);
+        ints[i] = (int32_t) random_u64();
+        sprintf(int_text[i], "%d", ints[i]);
+    }
+    long ops = iterations * INPUTS;
+    printf("%ld operations per decoder\n", ops);
+
+    // DevEui line to lower case hex: original in-place processing
+    int errors = 0;
+    char work[48];
+    uint64_t start = wall_ns();
+    for (long n = 0; n < iterations; n++) {
+        for (int i = 0; i < INPUTS; i++) {
+            strcpy(work, line_text[i]);
+            legacy_DevEui(work, (int) strlen(work));
+            sink += (uint8_t) work[0];
+            if (n == 0 && strcmp(work, expected_hex[i]) != 0) errors++;
+        }
+    }
+    report("legacy DevEui", wall_ns() - start, ops, errors);
+
+    // same result with the decoders
+    errors = 0;
+    char hex[17];
+    start = wall_ns();
+    for (long n = 0; n < iterations; n++) {
+        for (int i = 0; i < INPUTS; i++) {
+            uint8_t b[8];
+            // value starts after "+ID: DevEui, ", the tokenizer gives this offset
+            int count = at_decode_hex_bytes(line_text[i] + 13, 23, b, sizeof(b));
+            at_encode_hex(b, sizeof(b), hex);
+            sink += (uint8_t) hex[0];
+            if (n == 0 && (count != 8 || strcmp(hex, expected_hex[i]) != 0)) errors++;
+        }
+    }
+    report("hex bytes+enc", wall_ns() - start, ops, errors);
+    failed |= errors;
+
+    errors = 0;
+    start = wall_ns();
+    for (long n = 0; n < iterations; n++) {
+        for (int i = 0; i < INPUTS; i++) {
+            uint64_t value = 0;
+            bool ok = at_decode_hex_u64(eui_text[i], 23, &value);
+            sink += value;
+            if (n == 0 && (!ok || value != eui[i])) errors++;
+        }
+    }
+    report("hex u64", wall_ns() - start, ops, errors);
+    failed |= errors;
+
+    errors = 0;
+    start = wall_ns();
+    for (long n = 0; n < iterations; n++) {
+        for (int i = 0; i < INPUTS; i++) {
+            at_version v = { 0, 0, 0 };
+            bool ok = at_decode_version(version_text[i], strlen(version_text[i]), &v);
+            sink += v.patch;
+            if (n == 0 && (!ok || memcmp(&v, &versions[i], sizeof(v)) != 0)) errors++;
+        }
+    }
+    report("version", wall_ns() - start, ops, errors);
+    failed |= errors;
+
+    errors = 0;
+    start = wall_ns();
+    for (long n = 0; n < iterations; n++) {
+        for (int i = 0; i < INPUTS; i++) {
+            int32_t value = 0;
+            bool ok = at_decode_int(int_text[i], strlen(int_text[i]), &value);
+            sink += (uint32_t) value;
+            if (n == 0 && (!ok || value != ints[i])) errors++;
+        }
+    }
+    report("int", wall_ns() - start, ops, errors);
+    failed |= errors;
+
+    // lines through the tokenizer, malformed values must be rejected
+    errors = 0;
+    for (size_t i = 0; i < sizeof(line_cases) / sizeof(line_cases[0]); i++) {
+        errors += !run_line_case(&line_cases[i]);
+    }
+    printf("%-14s %25d errors\n", "lines", errors);
+    failed |= errors;
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+//
+// Round trip and size of the telemetry records (telemetry.h) against the Lab04 log text.
+//
+// usage: bench_telemetry [events] [mean_gap_s]
+//   events      events per run (default 100000)
+//   mean_gap_s  mean time between events, uniformly 0..2x (default 30)
+//
+// Random LED toggles and brightness steps as Lab04 makes them are encoded and decoded again.
+// Every decoded event must equal the original with the brightness quantized, and decoding
+// must reject every truncated record. Exits with 1 on the first mismatch.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lora_airtime.h"
+#include "telemetry.h"
+
+#define WRAP 1000 // pwm_config_set_wrap() in Lab04
+#define BRIGHT_STEP 10
+
+static uint32_t rng = 1;
+
+static uint32_t random_u32(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static bool same(const telemetry_event *a, const telemetry_event *b)
+{
+    return a->time_s == b->time_s && a->leds == b->leds && a->brightness == b->brightness;
+}
+
+int main(int argc, char **argv)
+{
+    int events = argc > 1 ? atoi(argv[1]) : 100000;
+    uint32_t mean_gap = argc > 2 ? (uint32_t) atoi(argv[2]) : 30;
+
+    telemetry_encoder enc;
+    telemetry_decoder dec;
+    telemetry_encoder_init(&enc, WRAP);
+    telemetry_decoder_init(&dec, WRAP);
+
+    telemetry_event state = { 0, 0, 500 };
+    size_t text_bytes = 0;
+    size_t binary_bytes = 0;
+    size_t histogram[TELEMETRY_MAX_RECORD + 1] = { 0 };
+    int errors = 0;
+    for (int i = 0; i < events && errors < 10; i++) {
+        state.time_s += random_u32() % (2 * mean_gap + 1);
+        if (i % 1000 == 999) {
+            state.time_s += 1000000; // long idle period
+        }
+        char text[80];
+        if (random_u32() % 3) {
+            int led = (int) (random_u32() % TELEMETRY_LEDS);
+            state.leds ^= (uint8_t) (1 << led);
+            text_bytes += (size_t) snprintf(text, sizeof(text), "Led %d toggled to state %d, seconds since boot: %u\n",
+                                            led + 1, state.leds >> led & 1, state.time_s);
+        } else {
+            int step = random_u32() % 2 ? BRIGHT_STEP : -BRIGHT_STEP;
+            if ((int) state.brightness + step >= 0 && (int) state.brightness + step < WRAP) {
+                state.brightness = (uint16_t) (state.brightness + step);
+            }
+            text_bytes += (size_t) snprintf(text, sizeof(text), "Brightness set to %u, seconds since boot: %u\n",
+                                            state.brightness, state.time_s);
+        }
+
+        uint8_t record[TELEMETRY_MAX_RECORD];
+        size_t len = telemetry_encode(&enc, &state, record);
+        binary_bytes += len;
+        histogram[len]++;
+
+        // every prefix of the record is truncated
+        for (size_t cut = 0; cut < len; cut++) {
+            telemetry_decoder copy = dec;
+            telemetry_event ignored;
+            if (telemetry_decode(&copy, record, cut, &ignored) != -1) {
+                printf("event %d: record truncated to %zu of %zu bytes was accepted\n", i, cut, len);
+                errors++;
+            }
+        }
+        telemetry_event decoded;
+        telemetry_event expected = state;
+        expected.brightness = telemetry_quantize(state.brightness, WRAP);
+        int used = telemetry_decode(&dec, record, len, &decoded);
+        if (used != (int) len || !dec.synced || !same(&decoded, &expected)) {
+            printf("event %d: t %u leds %x brightness %u decoded as t %u leds %x brightness %u (%d of %zu bytes)\n",
+                   i, expected.time_s, expected.leds, expected.brightness,
+                   decoded.time_s, decoded.leds, decoded.brightness, used, len);
+            errors++;
+        }
+    }
+
+    // quantization error over the whole range
+    int max_error = 0;
+    for (int b = 0; b <= WRAP; b++) {
+        int error = abs((int) telemetry_quantize((uint16_t) b, WRAP) - b);
+        max_error = error > max_error ? error : max_error;
+    }
+
+    double text_mean = (double) text_bytes / events;
+    double binary_mean = (double) binary_bytes / events;
+    printf("%d events, mean gap %u s\n", events, mean_gap);
+    printf("text    %6.1f bytes/event\n", text_mean);
+    printf("binary  %6.2f bytes/event, %.1fx smaller\n", binary_mean, text_mean / binary_mean);
+    printf("record sizes:");
+    for (int len = 1; len <= TELEMETRY_MAX_RECORD; len++) {
+        printf(" %d: %.1f%%", len, 100.0 * histogram[len] / events);
+    }
+    printf("\nbrightness error at most %d of %d\n", max_error, WRAP);
+    for (uint8_t dr = 0; dr <= LORA_DR_MAX; dr += 5) {
+        size_t payload = lora_max_payload(dr);
+        printf("DR%u %3zu byte uplink: %4.0f text events, %4.0f binary events\n",
+               dr, payload, payload / text_mean, payload / binary_mean);
+    }
+    printf("%s\n", errors ? "FAILED" : "all records decoded back");
+    return errors ? 1 : 0;
+}
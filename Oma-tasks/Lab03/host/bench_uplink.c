@@ -0,0 +1,215 @@
+//
+// Uplink batching and duty cycle tracking of the Lab03 client against the LoRa-E5 emulator.
+//
+// usage: bench_uplink [hours] [interval_s]
+//   hours       simulated time per run (default 4)
+//   interval_s  mean time between events, uniformly 0..2x (default 5)
+//
+// Events are LED toggles, either as the strings Lab04 logs ("Led %d toggled to state %d,
+// seconds since boot: %d") or as telemetry records (telemetry.h). Each data rate is run with
+// an uplink as soon as there is an event, without and with duty cycle tracking, and with
+// batching (uplink.h). The module limits the duty cycle to 1 % as LoRaMac does.
+//
+// The telemetry uplinks the module accepts are decoded as the receiver would, except for
+// one that is lost on the way. Every event of the other uplinks must decode synced and equal
+// to the one queued. Exits with 1 on the first mismatch.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "at_client.h"
+#include "at_decode.h"
+#include "lora_emu.h"
+#include "telemetry.h"
+#include "uplink.h"
+
+typedef struct {
+    const char *name;
+    size_t flush_size;
+    uint32_t max_age_ms;
+    uint32_t dc_credit_ms;
+    bool binary;
+} policy;
+
+static const policy policies[] = {
+    { "per event",          1, 0,     0,     false },
+    { "per event, dc",      1, 0,     36000, false },
+    { "batched, dc",        0, 60000, 36000, false },
+    { "batched, dc, bin",   0, 60000, 36000, true },
+};
+
+static const uint8_t data_rates[] = { 5, 2 };
+
+static lora_emu emu;
+static uint64_t now_us;
+static at_client at;
+static uint32_t rng = 1;
+static telemetry_encoder encoder;
+static telemetry_event led_state;
+
+#define MAX_EVENTS 16384
+#define LOST_UPLINK 3
+
+// receiving end of the telemetry uplinks
+static bool check_uplinks;
+static telemetry_event queued[MAX_EVENTS];  // events in the order they were queued
+static int queued_count;
+static int received;                        // events in the uplinks so far
+static uint32_t accepted;
+static telemetry_decoder decoder;
+static int errors;
+
+static void receive(const char *command)
+{
+    const char *hex = command + strlen("AT+MSGHEX=\"");
+    uint8_t payload[LORA_MAX_PAYLOAD];
+    int len = at_decode_hex_bytes(hex, strcspn(hex, "\""), payload, sizeof(payload));
+    // the lost uplink is decoded apart only to count its events
+    bool lost = accepted++ == LOST_UPLINK;
+    telemetry_decoder lost_decoder = decoder;
+    telemetry_decoder *dec = lost ? &lost_decoder : &decoder;
+    telemetry_decoder_start(dec);
+    for (int i = 0; i < len;) {
+        telemetry_event event;
+        int used = telemetry_decode(dec, payload + i, len - i, &event);
+        if (used < 0 || received == queued_count) {
+            printf("uplink %u: record at %d does not decode\n", accepted, i);
+            errors++;
+            return;
+        }
+        const telemetry_event *expected = &queued[received++];
+        if (!lost && (!dec->synced || event.time_s != expected->time_s || event.leds != expected->leds ||
+                      event.brightness != telemetry_quantize(expected->brightness, decoder.wrap))) {
+            printf("uplink %u: event %d decoded as %u s, leds %x (%ssynced), queued %u s, leds %x\n",
+                   accepted, received - 1, event.time_s, event.leds, dec->synced ? "" : "not ",
+                   expected->time_s, expected->leds);
+            errors++;
+            return;
+        }
+        i += used;
+    }
+}
+
+static void emu_send(const char *command)
+{
+    uint32_t uplinks = emu.counters.uplinks;
+    emu_write(&emu, command, strlen(command), now_us);
+    if (check_uplinks && emu.counters.uplinks != uplinks) {
+        receive(command);
+    }
+}
+
+static uint32_t random_u32(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static void step(void)
+{
+    char buffer[64];
+    size_t n;
+    while ((n = emu_read(&emu, now_us, buffer, sizeof(buffer))) > 0) {
+        at_feed(&at, buffer, n);
+    }
+    at_poll(&at, (uint32_t) (now_us / 1000));
+    now_us += 1000;
+}
+
+static bool joined;
+
+static void on_join(at_status status, const at_record *rec, void *ctx)
+{
+    joined = status == AT_STATUS_OK;
+}
+
+// Toggles a random LED and queues the event
+static void add_event(uplink *up, uint32_t seconds, bool binary, uint32_t now_ms)
+{
+    int led = (int) (random_u32() % TELEMETRY_LEDS);
+    led_state.leds ^= (uint8_t) (1 << led);
+    led_state.time_s = seconds;
+    if (binary) {
+        if (uplink_add_telemetry(up, &encoder, &led_state, now_ms) && queued_count < MAX_EVENTS) {
+            queued[queued_count++] = led_state;
+        }
+        return;
+    }
+    char event[64];
+    int len = snprintf(event, sizeof(event), "Led %d toggled to state %d, seconds since boot: %u",
+                       led + 1, led_state.leds >> led & 1, seconds);
+    uplink_add(up, (const uint8_t *) event, (size_t) len, now_ms);
+}
+
+int main(int argc, char **argv)
+{
+    double hours = argc > 1 ? atof(argv[1]) : 4;
+    double interval_s = argc > 2 ? atof(argv[2]) : 5;
+    uint64_t duration_us = (uint64_t) (hours * 3600e6);
+    uint32_t interval_ms = (uint32_t) (interval_s * 1000);
+
+    printf("%.1f h per run, an event every %.1f s on average\n", hours, interval_s);
+    printf("%-3s %-16s %7s %7s %7s %6s %6s %8s %9s %9s %9s\n", "DR", "policy", "events", "sent", "dropped",
+           "uplinks", "refused", "ev/uplink", "airtime s", "mean lat s", "max lat s");
+
+    for (size_t d = 0; d < sizeof(data_rates) / sizeof(data_rates[0]); d++) {
+        for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+            const policy *pol = &policies[p];
+            emu_config config;
+            emu_default_config(&config);
+            config.data_rate = data_rates[d];
+            emu_init(&emu, &config, 7);
+            now_us = 0;
+            rng = 12345;
+            telemetry_encoder_init(&encoder, 1000);
+            telemetry_decoder_init(&decoder, 1000);
+            led_state = (telemetry_event) { 0, 0, 500 };
+            check_uplinks = pol->binary;
+            queued_count = 0;
+            received = 0;
+            accepted = 0;
+            at_init(&at, emu_send);
+
+            at_timing join_timing;
+            at_timing_init(&join_timing, 10000, 10000, 10000, 1);
+            joined = false;
+            at_enqueue(&at, "AT+JOIN\r\n", "+JOIN: Done", &join_timing, on_join, NULL);
+            while (at_poll(&at, (uint32_t) (now_us / 1000)) > 0) {
+                step();
+            }
+            if (!joined) {
+                printf("join failed\n");
+                return 1;
+            }
+
+            uplink up;
+            uplink_config up_config = { data_rates[d], pol->flush_size, pol->max_age_ms, pol->dc_credit_ms };
+            uint64_t start_us = now_us;
+            uplink_init(&up, &at, &up_config, (uint32_t) (now_us / 1000));
+            uint64_t next_event_us = now_us;
+            while (now_us - start_us < duration_us) {
+                if (now_us >= next_event_us) {
+                    add_event(&up, (uint32_t) ((now_us - start_us) / 1000000), pol->binary, (uint32_t) (now_us / 1000));
+                    next_event_us += (uint64_t) (random_u32() % (2 * interval_ms + 1)) * 1000;
+                }
+                uplink_poll(&up, (uint32_t) (now_us / 1000));
+                step();
+            }
+
+            const uplink_stats *st = &up.stats;
+            printf("DR%u %-16s %7u %7u %7u %6u %6u %8.1f %9.1f %9.1f %9.1f\n", data_rates[d], pol->name,
+                   st->events, st->delivered, st->dropped, st->uplinks, emu.counters.no_band,
+                   st->uplinks ? (double) st->delivered / st->uplinks : 0.0,
+                   st->airtime_us / 1e6,
+                   st->delivered ? st->latency_ms / 1000.0 / st->delivered : 0.0,
+                   st->max_latency_ms / 1000.0);
+            if (errors) {
+                return 1;
+            }
+        }
+    }
+    printf("telemetry uplinks decoded with uplink %d lost\n", LOST_UPLINK + 1);
+    return 0;
+}
@@ -0,0 +1,118 @@
+//
+// Fuzzing entry point for the response tokenizer and the value decoders (at_decode.h).
+//
+// With clang the program is built for libFuzzer (LLVMFuzzerTestOneInput), for example
+//   CC=clang cmake -S host -B build && cmake --build build --target fuzz_decode
+//   build/fuzz_decode -max_len=512 corpus/
+// Otherwise FUZZ_MAIN adds a main() that runs each file given on the command line, or stdin
+// without arguments, so the same program replays a crashing input and works as an AFL target.
+//
+// The input is fed to the tokenizer as received characters and every decoder runs on the
+// value of every line. The decoders must stay inside their input and output, agree with
+// each other and give back what they accepted when it is printed again. A failed check aborts.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "at_decode.h"
+#include "at_tokenizer.h"
+
+#define CHECK(condition) do { if (!(condition)) { fprintf(stderr, "check failed: %s\n", #condition); abort(); } } while (0)
+
+static void check_record(const at_record *rec)
+{
+    CHECK(rec->len < AT_LINE_SIZE && rec->line[rec->len] == '\0');
+    CHECK(rec->value_offset + rec->value_len == rec->len);
+    if (rec->key_len > 0) {
+        CHECK(rec->line[0] == '+' && rec->line[rec->key_len + 1] == ':');
+        CHECK(rec->key_hash == at_hash(rec->line + 1, rec->key_len));
+    }
+}
+
+static void check_decoders(const char *value, size_t len)
+{
+    // hex bytes come back the same after encoding and decoding again
+    uint8_t bytes[16];
+    int count = at_decode_hex_bytes(value, len, bytes, sizeof(bytes));
+    CHECK(count >= -1 && count <= (int) sizeof(bytes));
+    if (count >= 0) {
+        char hex[2 * sizeof(bytes) + 1];
+        uint8_t again[sizeof(bytes)];
+        at_encode_hex(bytes, (size_t) count, hex);
+        CHECK(at_decode_hex_bytes(hex, 2 * (size_t) count, again, sizeof(again)) == count);
+        CHECK(memcmp(bytes, again, (size_t) count) == 0);
+    }
+
+    // the integer decoder accepts what fits in 8 bytes, with the first byte most significant
+    uint64_t u;
+    bool u_ok = at_decode_hex_u64(value, len, &u);
+    CHECK(u_ok == (count >= 1 && count <= 8));
+    if (u_ok) {
+        uint64_t expected = 0;
+        for (int i = 0; i < count; i++) {
+            expected = expected << 8 | bytes[i];
+        }
+        CHECK(u == expected);
+    }
+
+    at_version v;
+    if (at_decode_version(value, len, &v)) {
+        char text[24];
+        at_version again;
+        int n = snprintf(text, sizeof(text), "%u.%u.%u", v.major, v.minor, v.patch);
+        CHECK(at_decode_version(text, (size_t) n, &again));
+        CHECK(memcmp(&v, &again, sizeof(v)) == 0);
+    }
+
+    int32_t i32;
+    if (at_decode_int(value, len, &i32)) {
+        char text[16];
+        int32_t again;
+        int n = snprintf(text, sizeof(text), "%d", i32);
+        CHECK(at_decode_int(text, (size_t) n, &again) && again == i32);
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    // the whole input as one value, without the line buffer limit
+    check_decoders((const char *) data, size);
+
+    at_tokenizer tok;
+    at_record rec;
+    at_tok_init(&tok);
+    for (size_t i = 0; i < size; i++) {
+        if (at_tok_feed(&tok, (char) data[i], &rec)) {
+            check_record(&rec);
+            check_decoders(rec.line + rec.value_offset, rec.value_len);
+        }
+    }
+    return 0;
+}
+
+#ifdef FUZZ_MAIN
+static void run_file(FILE *file)
+{
+    static uint8_t data[1 << 16];
+    size_t size = fread(data, 1, sizeof(data), file);
+    LLVMFuzzerTestOneInput(data, size);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        run_file(stdin);
+        return 0;
+    }
+    for (int i = 1; i < argc; i++) {
+        FILE *file = fopen(argv[i], "rb");
+        if (!file) {
+            perror(argv[i]);
+            return 1;
+        }
+        run_file(file);
+        fclose(file);
+    }
+    return 0;
+}
+#endif
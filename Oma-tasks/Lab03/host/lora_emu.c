@@ -0,0 +1,319 @@
+//
+// LoRa-E5 module emulator, see lora_emu.h
+//
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "lora_airtime.h"
+#include "lora_emu.h"
+
+#define EMU_VERSION "4.0.11"
+#define EMU_DEV_ADDR "42:00:1C:B1"
+#define EMU_DEV_EUI "2C:F7:F1:20:32:30:A5:70"
+#define EMU_APP_EUI "80:00:00:00:00:00:00:06"
+
+void emu_default_config(emu_config *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->baud = 9600;
+    config->max_baud = 0;
+    config->delay_us = 2000;
+    config->connected = true;
+    config->join_us = 6000000;
+    config->data_rate = 5;
+    config->rx_windows_us = 2100000;
+    config->dc_credit_us = 36000000; // one hour at 1 %
+}
+
+void emu_init(lora_emu *emu, const emu_config *config, uint32_t seed)
+{
+    memset(emu, 0, sizeof(*emu));
+    emu->config = *config;
+    emu->rng = seed ? seed : 1;
+    emu->baud = config->baud;
+    emu->client_baud = config->baud;
+    emu->dc_credit_us = config->dc_credit_us;
+}
+
+void emu_set_client_baud(lora_emu *emu, uint32_t baud)
+{
+    emu->client_baud = baud;
+}
+
+uint32_t emu_baud(lora_emu *emu, uint64_t now_us)
+{
+    if (emu->next_baud && now_us >= emu->baud_switch_us) {
+        emu->baud = emu->next_baud;
+        emu->next_baud = 0;
+    }
+    return emu->baud;
+}
+
+// 8N1: ten bits per character
+static uint64_t emu_char_us(uint32_t baud)
+{
+    return 10 * 1000000ull / baud;
+}
+
+// Whether a character sent at baud is received correctly by a receiver at rx_baud
+static bool emu_char_ok(const lora_emu *emu, uint32_t baud, uint32_t rx_baud)
+{
+    return baud == rx_baud && (emu->config.max_baud == 0 || baud <= emu->config.max_baud);
+}
+
+const char *emu_dev_eui(void)
+{
+    return EMU_DEV_EUI;
+}
+
+// xorshift32
+static uint32_t emu_random(lora_emu *emu)
+{
+    uint32_t x = emu->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    emu->rng = x;
+    return x;
+}
+
+static bool emu_chance(lora_emu *emu, double rate)
+{
+    return rate > 0 && emu_random(emu) < rate * UINT32_MAX;
+}
+
+static void emu_put_line(lora_emu *emu, const char *text, uint64_t ready_us)
+{
+    if (emu->line_count == EMU_LINES) {
+        return;
+    }
+    emu_line *line = &emu->lines[(emu->line_head + emu->line_count) % EMU_LINES];
+    line->len = (size_t) snprintf(line->text, sizeof(line->text), "%s\r\n", text);
+    if (line->len >= sizeof(line->text)) {
+        line->len = sizeof(line->text) - 1;
+    }
+    // lines go out one after another
+    line->start_us = ready_us > emu->out_free_us ? ready_us : emu->out_free_us;
+    line->baud = emu_baud(emu, line->start_us);
+    emu->out_free_us = line->start_us + line->len * emu_char_us(line->baud);
+    emu->line_count++;
+}
+
+// Outputs a response line ready_us after the command, possibly dropped or after noise
+static void emu_respond(lora_emu *emu, const char *text, uint64_t ready_us)
+{
+    if (emu_chance(emu, emu->config.garbage_rate)) {
+        char noise[24];
+        size_t len = 4 + emu_random(emu) % 16;
+        for (size_t i = 0; i < len; i++) {
+            noise[i] = (char) (0x21 + emu_random(emu) % 94);
+        }
+        noise[len] = '\0';
+        emu_put_line(emu, noise, ready_us);
+        emu->counters.garbage++;
+    }
+    if (emu_chance(emu, emu->config.drop_rate)) {
+        emu->counters.dropped++;
+        return;
+    }
+    emu_put_line(emu, text, ready_us);
+    emu->counters.lines++;
+}
+
+// AT+UART=BR queries the rate, AT+UART=BR, <rate> changes it
+static void emu_uart(lora_emu *emu, const char *arg, uint64_t t)
+{
+    static const uint32_t rates[] = { 9600, 14400, 19200, 38400, 57600, 76800, 115200, 230400 };
+    while (*arg == ',' || *arg == ' ') {
+        arg++;
+    }
+    char response[EMU_LINE_SIZE];
+    if (*arg == '\0') {
+        snprintf(response, sizeof(response), "+UART: BR, %u", emu->baud);
+        emu_respond(emu, response, t);
+        return;
+    }
+    char *end;
+    unsigned long baud = strtoul(arg, &end, 10);
+    bool valid = false;
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        valid |= *end == '\0' && baud == rates[i];
+    }
+    if (!valid) {
+        emu_respond(emu, "+UART: ERROR(-1)", t);
+        return;
+    }
+    snprintf(response, sizeof(response), "+UART: BR, %lu", baud);
+    emu_respond(emu, response, t);
+    // the response still goes out at the old rate
+    emu->next_baud = (uint32_t) baud;
+    emu->baud_switch_us = emu->config.baud_on_reset ? UINT64_MAX : emu->out_free_us > t ? emu->out_free_us : t;
+}
+
+void emu_reset(lora_emu *emu, uint64_t now_us)
+{
+    if (emu->next_baud) {
+        emu->baud = emu->next_baud;
+        emu->next_baud = 0;
+    }
+    emu->line_count = 0;
+    emu->line_pos = 0;
+    emu->cmd_len = 0;
+    emu->in_free_us = now_us;
+    emu->out_free_us = now_us;
+    emu->joined = false;
+}
+
+static void emu_dc_refill(lora_emu *emu, uint64_t now_us)
+{
+    uint64_t gained = (now_us - emu->dc_refill_us) / EMU_DUTY_CYCLE;
+    emu->dc_credit_us += gained;
+    emu->dc_refill_us += gained * EMU_DUTY_CYCLE;
+    if (emu->dc_credit_us >= emu->config.dc_credit_us) {
+        emu->dc_credit_us = emu->config.dc_credit_us;
+        emu->dc_refill_us = now_us;
+    }
+}
+
+// AT+MSGHEX="<hex>"
+static void emu_msghex(lora_emu *emu, const char *arg, uint64_t t)
+{
+    if (!emu->joined) {
+        emu_respond(emu, "+MSGHEX: Please join network first", t);
+        return;
+    }
+    size_t digits = 0;
+    for (const char *p = arg; *p; p++) {
+        if (isxdigit((unsigned char) *p)) {
+            digits++;
+        } else if (*p != '"' && *p != ' ') {
+            emu_respond(emu, "+MSGHEX: ERROR(-1)", t);
+            return;
+        }
+    }
+    size_t len = digits / 2;
+    if (digits % 2 || len > lora_max_payload(emu->config.data_rate)) {
+        emu_respond(emu, "+MSGHEX: Length error 0", t);
+        return;
+    }
+    uint32_t airtime = lora_airtime_us(emu->config.data_rate, len);
+    if (emu->config.dc_credit_us) {
+        emu_dc_refill(emu, t);
+        if (emu->dc_credit_us < airtime) {
+            char response[EMU_LINE_SIZE];
+            uint64_t wait_us = (airtime - emu->dc_credit_us) * EMU_DUTY_CYCLE;
+            snprintf(response, sizeof(response), "+MSGHEX: No band in %llu ms",
+                     (unsigned long long) (wait_us + 999) / 1000);
+            emu_respond(emu, response, t);
+            emu->counters.no_band++;
+            return;
+        }
+        emu->dc_credit_us -= airtime;
+    }
+    emu->counters.uplinks++;
+    emu->counters.airtime_us += airtime;
+    emu_respond(emu, "+MSGHEX: Start", t);
+    emu_respond(emu, "+MSGHEX: Done", t + airtime + emu->config.rx_windows_us);
+}
+
+static void emu_command(lora_emu *emu, uint64_t now_us)
+{
+    emu->counters.commands++;
+    if (!emu->config.connected) {
+        return;
+    }
+    uint64_t t = now_us + emu->config.delay_us;
+    if (emu->config.jitter_us) {
+        t += emu_random(emu) % (emu->config.jitter_us + 1);
+    }
+
+    // module accepts commands in any case
+    char cmd[EMU_CMD_SIZE];
+    size_t len = 0;
+    for (; len < emu->cmd_len && emu->cmd[len] != '='; len++) {
+        cmd[len] = (char) toupper((unsigned char) emu->cmd[len]);
+    }
+    cmd[len] = '\0';
+    const char *arg = len < emu->cmd_len ? emu->cmd + len + 1 : "";
+
+    if (strcmp(cmd, "AT") == 0) {
+        emu_respond(emu, "+AT: OK", t);
+    } else if (strcmp(cmd, "AT+VER") == 0) {
+        emu_respond(emu, "+VER: " EMU_VERSION, t);
+    } else if (strcmp(cmd, "AT+ID") == 0) {
+        bool all = *arg == '\0';
+        if (all || strcasecmp(arg, "DevAddr") == 0) emu_respond(emu, "+ID: DevAddr, " EMU_DEV_ADDR, t);
+        if (all || strcasecmp(arg, "DevEui") == 0) emu_respond(emu, "+ID: DevEui, " EMU_DEV_EUI, t);
+        if (all || strcasecmp(arg, "AppEui") == 0) emu_respond(emu, "+ID: AppEui, " EMU_APP_EUI, t);
+    } else if (strcmp(cmd, "AT+JOIN") == 0) {
+        emu_respond(emu, "+JOIN: Start", t);
+        emu_respond(emu, "+JOIN: NORMAL, count 1, 0 channels, 0 retransmissions, 0 intervals", t);
+        t += emu->config.join_us;
+        emu_respond(emu, "+JOIN: Network joined", t);
+        emu_respond(emu, "+JOIN: NetID 000000 DevAddr " EMU_DEV_ADDR, t);
+        emu_respond(emu, "+JOIN: Done", t);
+        emu->joined = true;
+    } else if (strcmp(cmd, "AT+MSGHEX") == 0) {
+        emu_msghex(emu, arg, t);
+    } else if (strcmp(cmd, "AT+UART") == 0 && strncasecmp(arg, "BR", 2) == 0) {
+        emu_uart(emu, arg + 2, t);
+    } else {
+        emu_respond(emu, "+AT: ERROR(-1)", t);
+    }
+}
+
+void emu_write(lora_emu *emu, const char *data, size_t len, uint64_t now_us)
+{
+    uint64_t t = now_us > emu->in_free_us ? now_us : emu->in_free_us;
+    for (size_t i = 0; i < len; i++) {
+        t += emu_char_us(emu->client_baud);
+        char c = data[i];
+        if (!emu_char_ok(emu, emu->client_baud, emu_baud(emu, t))) {
+            c = (char) emu_random(emu);
+            emu->counters.corrupted++;
+        }
+        if (c == '\n') {
+            emu->cmd[emu->cmd_len] = '\0';
+            emu_command(emu, t);
+            emu->cmd_len = 0;
+        } else if (c != '\r' && emu->cmd_len < sizeof(emu->cmd) - 1) {
+            emu->cmd[emu->cmd_len++] = c;
+        }
+    }
+    emu->cmd[emu->cmd_len] = '\0';
+    emu->in_free_us = t;
+}
+
+// Arrival time of the next character of the oldest line
+static uint64_t emu_char_time(const lora_emu *emu)
+{
+    const emu_line *line = &emu->lines[emu->line_head];
+    return line->start_us + (emu->line_pos + 1) * emu_char_us(line->baud);
+}
+
+size_t emu_read(lora_emu *emu, uint64_t now_us, char *buffer, size_t size)
+{
+    size_t count = 0;
+    while (count < size && emu->line_count > 0 && emu_char_time(emu) <= now_us) {
+        emu_line *line = &emu->lines[emu->line_head];
+        char c = line->text[emu->line_pos++];
+        if (!emu_char_ok(emu, line->baud, emu->client_baud)) {
+            c = (char) emu_random(emu);
+            emu->counters.corrupted++;
+        }
+        buffer[count++] = c;
+        if (emu->line_pos == line->len) {
+            emu->line_head = (emu->line_head + 1) % EMU_LINES;
+            emu->line_count--;
+            emu->line_pos = 0;
+        }
+    }
+    return count;
+}
+
+uint64_t emu_next_event_us(const lora_emu *emu)
+{
+    return emu->line_count > 0 ? emu_char_time(emu) : UINT64_MAX;
+}
@@ -0,0 +1,110 @@
+//
+// LoRa-E5 module emulator for host builds of the Lab03 client.
+//
+// The emulator runs on the caller's simulated clock (microseconds). Characters move in both
+// directions at the configured baud rate: a command is processed when its line end has
+// arrived and each response line is output after the processing delay, one character time
+// per character. Responses can be delayed, jittered, dropped or preceded by noise.
+//
+// Both ends have their own baud rate. A character sent at a rate the receiver is not set to
+// arrives as a random byte, as do characters above the highest rate the wiring carries.
+// AT+UART=BR, <rate> answers at the old rate and switches after the response is out, or at
+// the next emu_reset() when configured so.
+//
+// AT+MSGHEX="<hex>" takes the time on air of the configured data rate (lora_airtime.h) and
+// answers with Done after the receive windows. The duty cycle is limited like LoRaMac does
+// it: a bucket of airtime credit refills at 1 % of the elapsed time, an uplink needs credit
+// for its time on air, otherwise the answer is "+MSGHEX: No band in <ms> ms".
+//
+// Commands: AT, AT+VER, AT+ID, AT+ID=DevAddr|DevEui|AppEui, AT+JOIN, AT+MSGHEX="..."
+// and AT+UART=BR[, rate]. Anything else is answered with +AT: ERROR(-1).
+//
+
+#ifndef LAB03_HOST_LORA_EMU_H
+#define LAB03_HOST_LORA_EMU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define EMU_LINE_SIZE 96
+#define EMU_CMD_SIZE 512        // fits AT+MSGHEX with the largest payload
+#define EMU_LINES 16
+#define EMU_DUTY_CYCLE 100      // 1 %
+
+typedef struct {
+    uint32_t baud;          // module rate at power on
+    uint32_t max_baud;      // characters at higher rates are corrupted, 0: no limit
+    bool baud_on_reset;     // AT+UART=BR takes effect only at the next reset
+    uint32_t delay_us;      // processing time before the first response line
+    uint32_t jitter_us;     // random extra delay, 0 to jitter_us
+    double drop_rate;       // probability that a response line is lost
+    double garbage_rate;    // probability that a line of noise is output before a response line
+    bool connected;         // false: module does not answer at all
+    uint32_t join_us;       // time from +JOIN: Start to +JOIN: Done
+    uint8_t data_rate;      // EU868 DR0..DR5
+    uint32_t rx_windows_us; // from the end of the uplink to +MSGHEX: Done
+    uint32_t dc_credit_us;  // largest duty cycle credit in airtime, 0: no limit
+} emu_config;
+
+typedef struct {
+    uint32_t commands;      // complete commands received
+    uint32_t lines;         // response lines output
+    uint32_t dropped;       // response lines lost
+    uint32_t garbage;       // noise lines output
+    uint32_t corrupted;     // characters lost to baud rate mismatch in either direction
+    uint32_t uplinks;
+    uint32_t no_band;       // uplinks refused by the duty cycle limit
+    uint64_t airtime_us;
+} emu_counters;
+
+typedef struct {
+    char text[EMU_LINE_SIZE];
+    size_t len;
+    uint32_t baud;
+    uint64_t start_us;      // first character is on the wire at start_us + one character time
+} emu_line;
+
+typedef struct {
+    emu_config config;
+    emu_counters counters;
+    uint32_t rng;
+    uint32_t baud;          // module rate
+    uint32_t next_baud;     // rate after AT+UART=BR, 0 if no change is pending
+    uint64_t baud_switch_us;
+    uint32_t client_baud;
+    // command input
+    char cmd[EMU_CMD_SIZE];
+    size_t cmd_len;
+    uint64_t in_free_us;    // when the client's transmitter is done with previous characters
+    // response output
+    emu_line lines[EMU_LINES];
+    int line_head;
+    int line_count;
+    size_t line_pos;        // characters of lines[line_head] already read
+    uint64_t out_free_us;   // when the module's transmitter is done with scheduled lines
+    bool joined;
+    // duty cycle
+    uint64_t dc_credit_us;
+    uint64_t dc_refill_us;  // credit has been added up to this time
+} lora_emu;
+
+// Configuration of a module that answers quickly and reliably at 9600 baud
+void emu_default_config(emu_config *config);
+void emu_init(lora_emu *emu, const emu_config *config, uint32_t seed);
+// Client sends characters to the module starting at now_us
+void emu_write(lora_emu *emu, const char *data, size_t len, uint64_t now_us);
+// Returns characters that have arrived at the client by now_us
+size_t emu_read(lora_emu *emu, uint64_t now_us, char *buffer, size_t size);
+// Time when the next character arrives at the client, UINT64_MAX if nothing is coming
+uint64_t emu_next_event_us(const lora_emu *emu);
+// DevEui as the module prints it
+const char *emu_dev_eui(void);
+// Client reconfigured its UART, both ends start at config.baud
+void emu_set_client_baud(lora_emu *emu, uint32_t baud);
+// Module rate at now_us
+uint32_t emu_baud(lora_emu *emu, uint64_t now_us);
+// Module restarts: output and network state are lost, a pending rate change takes effect
+void emu_reset(lora_emu *emu, uint64_t now_us);
+
+#endif //LAB03_HOST_LORA_EMU_H
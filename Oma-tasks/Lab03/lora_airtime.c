@@ -0,0 +1,25 @@
+#include "lora_airtime.h"
+
+#define LORAWAN_OVERHEAD 13 // MHDR, FHDR without options, FPort and MIC
+
+static const uint8_t max_payload[LORA_DR_MAX + 1] = { 51, 51, 51, 115, 222, 222 };
+
+size_t lora_max_payload(uint8_t data_rate) {
+    return data_rate <= LORA_DR_MAX ? max_payload[data_rate] : 0;
+}
+
+uint32_t lora_airtime_us(uint8_t data_rate, size_t payload_len) {
+    if (data_rate > LORA_DR_MAX) {
+        return 0;
+    }
+    int sf = 12 - data_rate;
+    int de = sf >= 11; // low data rate optimization is mandatory at SF11 and SF12 on 125 kHz
+    uint32_t symbol_us = (1u << sf) * 8; // 2^SF / 125 kHz
+    // payload symbols: 8 + ceil((8 PL - 4 SF + 28 + 16 CRC) / 4 (SF - 2 DE)) * (CR + 4)
+    int bits = 8 * (int) (payload_len + LORAWAN_OVERHEAD) - 4 * sf + 28 + 16;
+    int per_block = 4 * (sf - 2 * de);
+    int blocks = bits > 0 ? (bits + per_block - 1) / per_block : 0;
+    uint32_t symbols = 8 + (uint32_t) blocks * 5;
+    // preamble is 8 + 4.25 symbols
+    return symbol_us * (12 + symbols) + symbol_us / 4;
+}
@@ -0,0 +1,21 @@
+// Time on air of LoRaWAN uplinks in the EU868 region.
+//
+// Data rates DR0..DR5 are SF12..SF7 at 125 kHz. The time is computed with the formula of the
+// Semtech SX1276 data sheet for an explicit header, coding rate 4/5, CRC on and an 8 symbol
+// preamble. The payload is the application payload, the 13 bytes of LoRaWAN framing are
+// added here.
+
+#ifndef LAB03_LORA_AIRTIME_H
+#define LAB03_LORA_AIRTIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LORA_DR_MAX 5
+#define LORA_MAX_PAYLOAD 222 // largest application payload of any data rate
+
+// Largest application payload of the data rate without MAC commands in the frame
+size_t lora_max_payload(uint8_t data_rate);
+uint32_t lora_airtime_us(uint8_t data_rate, size_t payload_len);
+
+#endif //LAB03_LORA_AIRTIME_H
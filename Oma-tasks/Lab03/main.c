@@ -3,27 +3,75 @@
 #include "hardware/uart.h"
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
+#include "at_baud.h"
+#include "at_client.h"
+#include "at_decode.h"
+#include "settings.h"
 
 #define SW_0_PIN 9
 #define TX_PIN 4
 #define RX_PIN 5
 #define UART_ID uart1
 #define BAUD_RATE 9600
+#define FAST_BAUD_RATE 115200
 #define TIMEOUT_MS 500
+#define MIN_TIMEOUT_MS 20
+#define MAX_TIMEOUT_MS 2000
+#define MAX_ATTEMPTS 5
+#define DEBOUNCE_MS 20
 #define BUFFER_SIZE 256
+#define DEV_EUI_LABEL "DevEui,"
+#define APP_EUI_LABEL "AppEui,"
+#define DEV_ADDR_LABEL "DevAddr,"
 #define SEPARATOR "\n----------------------------------------\n"
 
 void send_command(const char* command);
-bool read_response(const char expected_response[], int response_len, int max_attempts, char *pstring_to_store_to);
 void uart_rx_handler();
-bool process_uart_data(const char expected_response[], int response_len, char *pstring_to_store_to);
-void process_DevEui(char DevEui[], int DevEui_len);
+void feed_at_client(at_client *at);
+void wait_for_button();
+bool button_pressed(uint32_t now_ms);
+void set_baud(uint32_t baud);
+void on_connect(uint32_t baud, void *ctx);
+void read_identity();
+void print_identity();
+bool decode_id(const at_record *rec, const char *label, uint8_t *id, size_t size);
+void on_check(at_status status, const at_record *rec, void *ctx);
+void on_version(at_status status, const at_record *rec, void *ctx);
+void on_id(at_status status, const at_record *rec, void *ctx);
+
+// an ID read with AT+ID=<name> and where it is stored
+typedef struct {
+    const char *label;
+    uint8_t *id;
+    size_t size;
+    bool last;              // identity is complete when this one has been read
+} id_field;
 
 char circular_buffer[BUFFER_SIZE];
 volatile int buffer_head = 0;
 volatile int buffer_tail = 0;
 
+static at_client at;
+static at_baud baud;
+static uint32_t saved_baud;
+static bool session_active;         // from a press of SW_0 until the results are printed
+// SW_0 is pulled up: true is released
+static bool button_level = true;    // debounced level
+static bool button_raw = true;      // level at the last poll
+static uint32_t button_changed_ms;  // when button_raw last changed
+// response times are learned per command, see at_timing.h
+static at_timing connect_timing;
+static at_timing id_timing;
+// identity of the module, cached in the EEPROM so that a known module needs only one command
+static lora_identity identity;
+static bool identity_valid;
+// EEPROM writes wait for each page to be programmed, they are done between sessions
+static bool save_baud_pending;
+static bool save_identity_pending;
+static const id_field dev_eui_field = { DEV_EUI_LABEL, identity.dev_eui, sizeof(identity.dev_eui), false };
+static const id_field dev_addr_field = { DEV_ADDR_LABEL, identity.dev_addr, sizeof(identity.dev_addr), false };
+static const id_field app_eui_field = { APP_EUI_LABEL, identity.app_eui, sizeof(identity.app_eui), true };
+
 int main() {
     stdio_init_all();
 
@@ -31,7 +79,11 @@ int main() {
     gpio_set_dir(SW_0_PIN, GPIO_IN);
     gpio_pull_up(SW_0_PIN);
 
-    uart_init(UART_ID, BAUD_RATE);
+    // the module keeps the rate it was switched to, start with the one that worked last time
+    settings_init();
+    saved_baud = settings_load_baud(BAUD_RATE);
+    identity_valid = settings_load_identity(&identity);
+    uart_init(UART_ID, saved_baud);
     gpio_set_function(TX_PIN, GPIO_FUNC_UART);
     gpio_set_function(RX_PIN, GPIO_FUNC_UART);
 
@@ -40,49 +92,32 @@ int main() {
     irq_set_exclusive_handler(UART1_IRQ, uart_rx_handler);
     irq_set_enabled(UART1_IRQ, true);
 
-    int state = 1;
-    char read_data[BUFFER_SIZE];
+    at_init(&at, send_command);
+    at_timing_init(&connect_timing, TIMEOUT_MS, MIN_TIMEOUT_MS, MAX_TIMEOUT_MS, MAX_ATTEMPTS);
+    at_timing_init(&id_timing, TIMEOUT_MS, MIN_TIMEOUT_MS, MAX_TIMEOUT_MS, 2);
+    wait_for_button();
 
+    // the loop never blocks during a session: responses are handled by the command callbacks
     while (true) {
-        if (state == 1) {
-            printf(SEPARATOR);
-            printf("Press SW_0 to start communication with the LoRa module...\n");
-            while (gpio_get(SW_0_PIN)) {
-                sleep_ms(10);
-            }
-            state = 2;
-        } else if (state == 2) {
+        feed_at_client(&at);
+        uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+        at_poll(&at, now_ms);
+
+        if (!session_active && save_baud_pending) {
+            settings_save_baud(saved_baud);
+            save_baud_pending = false;
+        }
+        if (!session_active && save_identity_pending) {
+            settings_save_identity(&identity);
+            save_identity_pending = false;
+        }
+
+        // polled during a session too so that a press during it or held from the previous
+        // one doesn't start the next session, only a new press does
+        if (button_pressed(now_ms) && !session_active) {
             printf("Connecting to LoRa module...\n");
-            send_command("AT\r\n");
-            if (read_response("+AT: OK", strlen("+AT: OK"), 5, read_data) == true) {
-                printf("Connected to LoRa module\n");
-                printf("Response: %s", read_data);
-                state = 3;
-            } else {
-                printf("Module not responding\n");
-                state = 1;
-            }
-        } else if (state == 3) {
-            printf("Reading firmware ver...\n");
-            send_command("AT+VER\r\n");
-            if (read_response("+VER: ", strlen("+VER: "), 5, read_data) == true) {
-                printf("Response: %s", read_data);
-                state = 4;
-            } else {
-                printf("Module not responding\n");
-                state = 1;
-            }
-        } else if(state == 4) {
-            printf("Reading DevEui...\n");
-            send_command("AT+ID=DevEui\r\n");
-            if (read_response("+ID: DevEui,", strlen("+ID: DevEui,"), 5, read_data) == true) {
-                printf("Response: %s", read_data);
-                process_DevEui(read_data, strlen(read_data));
-                printf("Formatted DevEui: %s", read_data);
-            } else {
-                printf("Module not responding\n");
-            }
-            state = 1;
+            session_active = true;
+            at_baud_start(&baud, &at, &connect_timing, saved_baud, FAST_BAUD_RATE, set_baud, on_connect, NULL);
         }
     }
     return 0;
@@ -92,16 +127,140 @@ void send_command(const char* command) {
     uart_puts(UART_ID, command);
 }
 
-bool read_response(const char expected_response[], const int response_len, int max_attempts, char *pstring_to_store_to) {
-    for (int i = 0; i < max_attempts; i++) {
-        sleep_ms(TIMEOUT_MS);
-        bool msg_status = process_uart_data(expected_response, response_len, pstring_to_store_to);
-        if (msg_status == true) {
-            return true;
-        }
-        printf("No response from module, retrying...\n");
+void wait_for_button() {
+    at_clear(&at);
+    session_active = false;
+    printf(SEPARATOR);
+    printf("Press SW_0 to start communication with the LoRa module...\n");
+}
+
+// Returns true once per press, when the button has gone down and stayed down for DEBOUNCE_MS
+bool button_pressed(uint32_t now_ms) {
+    bool raw = gpio_get(SW_0_PIN);
+    if (raw != button_raw) {
+        button_raw = raw;
+        button_changed_ms = now_ms;
+        return false;
+    }
+    if (raw == button_level || now_ms - button_changed_ms < DEBOUNCE_MS) {
+        return false;
+    }
+    button_level = raw;
+    return !raw;
+}
+
+void set_baud(uint32_t baud) {
+    uart_set_baudrate(UART_ID, baud);
+}
+
+void on_connect(uint32_t baud, void *ctx) {
+    if (baud == 0) {
+        // no answer to a probe at any rate or to MAX_ATTEMPTS sends at the saved rate
+        printf("Module not responding\n");
+        wait_for_button();
+        return;
+    }
+    printf("Connected to LoRa module at %u baud\n", baud);
+    if (baud != saved_baud) {
+        saved_baud = baud;
+        save_baud_pending = true;
+    }
+
+    if (identity_valid) {
+        // the DevEui is unique to the module, if it matches the rest of the cache is valid too
+        printf("Checking cached identity...\n");
+        at_enqueue(&at, "AT+ID=DevEui\r\n", "+ID: " DEV_EUI_LABEL, &id_timing, on_check, NULL);
+    } else {
+        read_identity();
+    }
+}
+
+void read_identity() {
+    // identification commands are queued together, each one is sent when the previous response arrives
+    printf("Reading firmware ver and IDs...\n");
+    identity_valid = false;
+    at_enqueue(&at, "AT+VER\r\n", "+VER: ", &id_timing, on_version, NULL);
+    at_enqueue(&at, "AT+ID=DevEui\r\n", "+ID: " DEV_EUI_LABEL, &id_timing, on_id, (void *) &dev_eui_field);
+    at_enqueue(&at, "AT+ID=DevAddr\r\n", "+ID: " DEV_ADDR_LABEL, &id_timing, on_id, (void *) &dev_addr_field);
+    at_enqueue(&at, "AT+ID=AppEui\r\n", "+ID: " APP_EUI_LABEL, &id_timing, on_id, (void *) &app_eui_field);
+}
+
+void print_identity() {
+    char formatted[2 * sizeof(identity.dev_eui) + 1];
+    printf("Firmware version: %u.%u.%u\n", identity.version.major, identity.version.minor, identity.version.patch);
+    at_encode_hex(identity.dev_eui, sizeof(identity.dev_eui), formatted);
+    printf("Formatted DevEui: %s\n", formatted);
+    at_encode_hex(identity.app_eui, sizeof(identity.app_eui), formatted);
+    printf("Formatted AppEui: %s\n", formatted);
+    at_encode_hex(identity.dev_addr, sizeof(identity.dev_addr), formatted);
+    printf("Formatted DevAddr: %s\n", formatted);
+    printf("Response time %u ms (+/- %u ms), timeout %u ms\n", at_timing_srtt_ms(&id_timing),
+           at_timing_rttvar_ms(&id_timing), at_timing_timeout_ms(&id_timing));
+}
+
+// Decodes an ID response such as "+ID: DevEui, 2C:F7:F1:20:32:30:A5:70" to exactly size bytes.
+// The label was checked when the response was matched.
+bool decode_id(const at_record *rec, const char *label, uint8_t *id, size_t size) {
+    const char *value = rec->line + rec->value_offset;
+    size_t skip = strlen(label);
+    while (skip < rec->value_len && value[skip] == ' ') {
+        skip++;
+    }
+    return at_decode_hex_bytes(value + skip, rec->value_len - skip, id, size) == (int) size;
+}
+
+void on_check(at_status status, const at_record *rec, void *ctx) {
+    if (status == AT_STATUS_TIMEOUT) {
+        printf("Module stopped responding\n");
+        wait_for_button();
+        return;
+    }
+    printf("Response: %s\n", rec->line);
+    uint8_t DevEui[sizeof(identity.dev_eui)];
+    if (decode_id(rec, DEV_EUI_LABEL, DevEui, sizeof(DevEui)) &&
+        memcmp(DevEui, identity.dev_eui, sizeof(DevEui)) == 0) {
+        printf("Same module as last time, identity from EEPROM\n");
+        print_identity();
+        wait_for_button();
+    } else {
+        printf("Module has changed\n");
+        read_identity();
+    }
+}
+
+void on_version(at_status status, const at_record *rec, void *ctx) {
+    if (status == AT_STATUS_TIMEOUT) {
+        printf("Module stopped responding\n");
+        wait_for_button();
+        return;
+    }
+    printf("Response: %s\n", rec->line);
+    if (!at_decode_version(rec->line + rec->value_offset, rec->value_len, &identity.version)) {
+        // the identity must not be saved with a version that wasn't read
+        printf("Invalid firmware version\n");
+        wait_for_button();
+    }
+}
+
+void on_id(at_status status, const at_record *rec, void *ctx) {
+    const id_field *field = ctx;
+    if (status == AT_STATUS_TIMEOUT) {
+        printf("Module stopped responding\n");
+        wait_for_button();
+        return;
+    }
+    printf("Response: %s\n", rec->line);
+    if (!decode_id(rec, field->label, field->id, field->size)) {
+        printf("Invalid %.*s\n", (int) strlen(field->label) - 1, field->label);
+        wait_for_button();
+        return;
+    }
+    if (field->last) {
+        identity_valid = true;
+        save_identity_pending = true;
+        print_identity();
+        wait_for_button();
     }
-    return false;
 }
 
 void uart_rx_handler() {
@@ -118,40 +277,11 @@ void uart_rx_handler() {
     }
 }
 
-bool process_uart_data(const char expected_response[], const int response_len, char *pstring_to_store_to) {
-    int datalen = 0;
-    char data[BUFFER_SIZE];
-
-    // Check if there is data in the circular buffer
+// Moves received characters from the interrupt buffer to the AT engine
+void feed_at_client(at_client *at) {
     while (buffer_tail != buffer_head) {
-        data[datalen] = circular_buffer[buffer_tail];
+        char c = circular_buffer[buffer_tail];
         buffer_tail = (buffer_tail + 1) % BUFFER_SIZE;
-        datalen++;
-    }
-    if (strncmp(data, expected_response, response_len) == 0){
-        strncpy(pstring_to_store_to, data, datalen);
-        pstring_to_store_to[datalen] = '\0';
-        return true;
-    }
-    return false;
-}
-
-void process_DevEui(char DevEui[], const int DevEui_len) {
-
-    for (int strlen = 0; strlen < DevEui_len; strlen++){
-        if (DevEui[strlen] == ':'){
-            for (int i = strlen; i < DevEui_len; i++){
-                DevEui[i] = DevEui[i + 1]; // remove : from the string
-            }
-        }
-        DevEui[strlen] = tolower(DevEui[strlen]); // convert to lowercase
-    }
-
-    // remove "+ID: DevEui, " from the string
-    for (int i = 0; i < strlen("+ID: DevEui "); i++){
-        for (int j = 0; j < DevEui_len; j++){
-            DevEui[j] = DevEui[j + 1];
-        }
+        at_feed(at, &c, 1);
     }
 }
-
@@ -0,0 +1,112 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "settings.h"
+
+#define EEPROM_I2C i2c0
+#define EEPROM_SDA_PIN 16
+#define EEPROM_SCL_PIN 17
+#define EEPROM_ADDR 0x50
+#define EEPROM_WRITE_DELAY_MS 5
+// records start at 64 byte pages, away from the areas the Lab04 programs use
+// each record is followed by its CRC-16
+#define BAUD_RECORD_ADDR 0x7000 // baud rate, 4 bytes
+#define IDENTITY_RECORD_ADDR 0x7040 // version (3 x 2 bytes), DevEui, AppEui, DevAddr
+#define IDENTITY_RECORD_SIZE 26
+#define RECORD_MAX IDENTITY_RECORD_SIZE
+
+// CRC-16/CCITT-FALSE as in the Lab04 log entries
+static uint16_t crc16(const uint8_t *data, size_t length) {
+    uint8_t x;
+    uint16_t crc = 0xFFFF;
+    while (length--) {
+        x = crc >> 8 ^ *data++;
+        x ^= x >> 4;
+        crc = (crc << 8) ^ ((uint16_t) (x << 12)) ^ ((uint16_t) (x << 5)) ^ ((uint16_t) x);
+    }
+    return crc;
+}
+
+void settings_init(void) {
+    i2c_init(EEPROM_I2C, 100 * 1000);
+    gpio_set_function(EEPROM_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(EEPROM_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(EEPROM_SDA_PIN);
+    gpio_pull_up(EEPROM_SCL_PIN);
+}
+
+static bool settings_read(uint16_t addr, uint8_t *data, size_t len) {
+    uint8_t addr_bytes[2] = { addr >> 8, addr & 0xFF };
+    return i2c_write_blocking(EEPROM_I2C, EEPROM_ADDR, addr_bytes, 2, true) == 2 &&
+           i2c_read_blocking(EEPROM_I2C, EEPROM_ADDR, data, len, false) == (int) len;
+}
+
+// data must not cross a 64 byte page
+static void settings_write(uint16_t addr, const uint8_t *data, size_t len) {
+    uint8_t buffer[2 + 64];
+    buffer[0] = addr >> 8;
+    buffer[1] = addr & 0xFF;
+    for (size_t i = 0; i < len; i++) {
+        buffer[2 + i] = data[i];
+    }
+    i2c_write_blocking(EEPROM_I2C, EEPROM_ADDR, buffer, 2 + len, false);
+    sleep_ms(EEPROM_WRITE_DELAY_MS);
+}
+
+// Reads a record of len bytes and its CRC, returns false if the CRC doesn't match
+static bool settings_load_record(uint16_t addr, uint8_t *record, size_t len) {
+    uint8_t buffer[RECORD_MAX + 2];
+    if (!settings_read(addr, buffer, len + 2) || crc16(buffer, len) != (buffer[len] << 8 | buffer[len + 1])) {
+        return false;
+    }
+    memcpy(record, buffer, len);
+    return true;
+}
+
+static void settings_save_record(uint16_t addr, const uint8_t *record, size_t len) {
+    uint8_t buffer[RECORD_MAX + 2];
+    memcpy(buffer, record, len);
+    uint16_t crc = crc16(record, len);
+    buffer[len] = crc >> 8;
+    buffer[len + 1] = crc & 0xFF;
+    settings_write(addr, buffer, len + 2);
+}
+
+uint32_t settings_load_baud(uint32_t fallback) {
+    uint8_t record[4];
+    if (!settings_load_record(BAUD_RECORD_ADDR, record, sizeof(record))) {
+        return fallback;
+    }
+    return (uint32_t) record[0] << 24 | (uint32_t) record[1] << 16 | (uint32_t) record[2] << 8 | record[3];
+}
+
+void settings_save_baud(uint32_t baud) {
+    uint8_t record[4] = { baud >> 24, baud >> 16, baud >> 8, baud };
+    settings_save_record(BAUD_RECORD_ADDR, record, sizeof(record));
+}
+
+bool settings_load_identity(lora_identity *identity) {
+    uint8_t record[IDENTITY_RECORD_SIZE];
+    if (!settings_load_record(IDENTITY_RECORD_ADDR, record, sizeof(record))) {
+        return false;
+    }
+    identity->version.major = record[0] << 8 | record[1];
+    identity->version.minor = record[2] << 8 | record[3];
+    identity->version.patch = record[4] << 8 | record[5];
+    memcpy(identity->dev_eui, record + 6, 8);
+    memcpy(identity->app_eui, record + 14, 8);
+    memcpy(identity->dev_addr, record + 22, 4);
+    return true;
+}
+
+void settings_save_identity(const lora_identity *identity) {
+    uint8_t record[IDENTITY_RECORD_SIZE] = {
+        identity->version.major >> 8, identity->version.major & 0xFF,
+        identity->version.minor >> 8, identity->version.minor & 0xFF,
+        identity->version.patch >> 8, identity->version.patch & 0xFF,
+    };
+    memcpy(record + 6, identity->dev_eui, 8);
+    memcpy(record + 14, identity->app_eui, 8);
+    memcpy(record + 22, identity->dev_addr, 4);
+    settings_save_record(IDENTITY_RECORD_ADDR, record, sizeof(record));
+}
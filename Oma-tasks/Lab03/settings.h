@@ -0,0 +1,30 @@
+// Settings kept in the AT24C256 EEPROM over resets.
+//
+// Each setting is a small record followed by a CRC-16 so that an erased or half written
+// record is detected and the default is used instead.
+
+#ifndef LAB03_SETTINGS_H
+#define LAB03_SETTINGS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "at_decode.h"
+
+// What the module reports about itself, see main.c
+typedef struct {
+    at_version version;
+    uint8_t dev_eui[8];
+    uint8_t app_eui[8];
+    uint8_t dev_addr[4];    // last one read, changes when the module joins a network
+} lora_identity;
+
+// Sets up the I2C bus of the EEPROM
+void settings_init(void);
+// Returns the saved module baud rate or fallback if none is saved
+uint32_t settings_load_baud(uint32_t fallback);
+void settings_save_baud(uint32_t baud);
+// Returns false if no identity is saved
+bool settings_load_identity(lora_identity *identity);
+void settings_save_identity(const lora_identity *identity);
+
+#endif //LAB03_SETTINGS_H
@@ -0,0 +1,112 @@
+#include "at_decode.h"
+#include "telemetry.h"
+
+#define FLAG_LEVEL 0x01
+#define FLAG_ABSOLUTE 0x02
+#define LEDS_SHIFT 2
+#define LEDS_MASK ((1 << TELEMETRY_LEDS) - 1)
+#define TIME_SHIFT (LEDS_SHIFT + TELEMETRY_LEDS)
+#define LEVEL_MAX 255
+
+static uint8_t telemetry_level(uint16_t brightness, uint16_t wrap) {
+    if (brightness >= wrap) {
+        return LEVEL_MAX;
+    }
+    return (uint8_t) (((uint32_t) brightness * LEVEL_MAX + wrap / 2) / wrap);
+}
+
+static uint16_t telemetry_brightness(uint8_t level, uint16_t wrap) {
+    return (uint16_t) (((uint32_t) level * wrap + LEVEL_MAX / 2) / LEVEL_MAX);
+}
+
+uint16_t telemetry_quantize(uint16_t brightness, uint16_t wrap) {
+    return telemetry_brightness(telemetry_level(brightness, wrap), wrap);
+}
+
+void telemetry_encoder_init(telemetry_encoder *enc, uint16_t wrap) {
+    enc->wrap = wrap;
+    enc->prev_s = 0;
+    enc->prev_level = 0;
+    telemetry_key(enc);
+}
+
+void telemetry_key(telemetry_encoder *enc) {
+    enc->since_key = TELEMETRY_KEY_INTERVAL;
+}
+
+size_t telemetry_encode(telemetry_encoder *enc, const telemetry_event *event, uint8_t *out) {
+    uint8_t level = telemetry_level(event->brightness, enc->wrap);
+    // times going backwards can't be a delta
+    bool absolute = enc->since_key >= TELEMETRY_KEY_INTERVAL || event->time_s < enc->prev_s;
+    bool has_level = absolute || level != enc->prev_level;
+    uint32_t time = absolute ? event->time_s : event->time_s - enc->prev_s;
+    uint64_t value = (uint64_t) time << TIME_SHIFT | (uint64_t) (event->leds & LEDS_MASK) << LEDS_SHIFT |
+                     (absolute ? FLAG_ABSOLUTE : 0) | (has_level ? FLAG_LEVEL : 0);
+    size_t len = 0;
+    while (value >= 0x80) {
+        out[len++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (uint8_t) value;
+    if (has_level) {
+        out[len++] = level;
+    }
+    enc->prev_s = event->time_s;
+    enc->prev_level = level;
+    enc->since_key = absolute ? 1 : enc->since_key + 1;
+    return len;
+}
+
+size_t telemetry_encode_hex(telemetry_encoder *enc, const telemetry_event *event, char *out) {
+    uint8_t record[TELEMETRY_MAX_RECORD];
+    size_t len = telemetry_encode(enc, event, record);
+    at_encode_hex(record, len, out);
+    return 2 * len;
+}
+
+void telemetry_decoder_init(telemetry_decoder *dec, uint16_t wrap) {
+    dec->wrap = wrap;
+    dec->synced = false;
+    dec->time_s = 0;
+    dec->leds = 0;
+    dec->level = 0;
+}
+
+void telemetry_decoder_start(telemetry_decoder *dec) {
+    dec->synced = false;
+}
+
+int telemetry_decode(telemetry_decoder *dec, const uint8_t *data, size_t len, telemetry_event *event) {
+    uint64_t value = 0;
+    size_t i = 0;
+    for (int shift = 0;; shift += 7) {
+        if (i == len || i == TELEMETRY_MAX_RECORD - 1) {
+            return -1;
+        }
+        value |= (uint64_t) (data[i] & 0x7F) << shift;
+        if (!(data[i++] & 0x80)) {
+            break;
+        }
+    }
+    uint64_t time = value >> TIME_SHIFT;
+    if (time > UINT32_MAX) {
+        return -1;
+    }
+    if (value & FLAG_LEVEL) {
+        if (i == len) {
+            return -1;
+        }
+        dec->level = data[i++];
+    }
+    if (value & FLAG_ABSOLUTE) {
+        dec->time_s = (uint32_t) time;
+        dec->synced = true;
+    } else {
+        dec->time_s += (uint32_t) time;
+    }
+    dec->leds = (value >> LEDS_SHIFT) & LEDS_MASK;
+    event->time_s = dec->time_s;
+    event->leds = dec->leds;
+    event->brightness = telemetry_brightness(dec->level, dec->wrap);
+    return (int) i;
+}
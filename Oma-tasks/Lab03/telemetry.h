@@ -0,0 +1,66 @@
+// Compact binary records for the LED events of Lab04.
+//
+// An event is the state after a change: time, on/off state of each LED and the brightness.
+// Records are variable length:
+//   varint   time << 5 | leds << 2 | absolute << 1 | has_level
+//   byte     brightness level, only if has_level
+// The varint holds 7 bits per byte, low bits first, the top bit of each byte is set when more
+// bytes follow. Time is in seconds since the previous record, or since boot when absolute is
+// set. The brightness is quantized to 0..255 of the PWM wrap and sent only when it changes.
+// A toggle a few minutes after the previous event takes 2 bytes, the same text takes 50.
+//
+// A lost uplink would shift all later times, so the first record of every uplink is absolute
+// and carries the level: uplink_add_telemetry() calls telemetry_key() when a record starts a
+// new payload. Every TELEMETRY_KEY_INTERVAL records is absolute as well. The receiver calls
+// telemetry_decoder_start() before the first record of each payload, events before the first
+// absolute record of the payload are reported as not synced.
+
+#ifndef LAB03_TELEMETRY_H
+#define LAB03_TELEMETRY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEMETRY_LEDS 3
+#define TELEMETRY_MAX_RECORD 7 // 6 byte varint and the level
+#define TELEMETRY_KEY_INTERVAL 32
+
+typedef struct {
+    uint32_t time_s;        // seconds since boot
+    uint8_t leds;           // bit n is LED n
+    uint16_t brightness;    // PWM level 0..wrap
+} telemetry_event;
+
+typedef struct {
+    uint16_t wrap;
+    uint32_t prev_s;
+    uint8_t prev_level;
+    int since_key;          // records since the last absolute one
+} telemetry_encoder;
+
+typedef struct {
+    uint16_t wrap;
+    bool synced;            // an absolute record has been decoded in this payload
+    uint32_t time_s;
+    uint8_t leds;
+    uint8_t level;
+} telemetry_decoder;
+
+void telemetry_encoder_init(telemetry_encoder *enc, uint16_t wrap);
+// Writes the record of the event to out, returns its length (at most TELEMETRY_MAX_RECORD)
+size_t telemetry_encode(telemetry_encoder *enc, const telemetry_event *event, uint8_t *out);
+// Same as above as hex digits for AT+MSGHEX, out gets 2 * length digits and a terminating null
+size_t telemetry_encode_hex(telemetry_encoder *enc, const telemetry_event *event, char *out);
+// Makes the next record absolute
+void telemetry_key(telemetry_encoder *enc);
+
+void telemetry_decoder_init(telemetry_decoder *dec, uint16_t wrap);
+// Called at the start of every payload, the payload before it may have been lost
+void telemetry_decoder_start(telemetry_decoder *dec);
+// Decodes the record at data. Returns its length or -1 if the record is truncated or invalid.
+int telemetry_decode(telemetry_decoder *dec, const uint8_t *data, size_t len, telemetry_event *event);
+// Brightness the decoder reports for a PWM level
+uint16_t telemetry_quantize(uint16_t brightness, uint16_t wrap);
+
+#endif //LAB03_TELEMETRY_H
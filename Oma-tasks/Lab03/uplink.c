@@ -0,0 +1,191 @@
+#include <string.h>
+#include "at_decode.h"
+#include "uplink.h"
+
+#define NO_BAND "No band in "
+
+void uplink_init(uplink *up, at_client *at, const uplink_config *config, uint32_t now_ms) {
+    memset(up, 0, sizeof(*up));
+    up->at = at;
+    up->config = *config;
+    size_t max_payload = lora_max_payload(config->data_rate);
+    if (up->config.flush_size == 0 || up->config.flush_size > max_payload) {
+        up->config.flush_size = max_payload;
+    }
+    // resending an uplink would send it twice, so there is one attempt. The answer comes after
+    // the whole command has been sent, which takes up to 0.5 s at 9600 baud.
+    at_timing_init(&up->start_timing, 1000, 1000, 2000, 1);
+    uint32_t done_ms = lora_airtime_us(config->data_rate, max_payload) / 1000 + UPLINK_RX_WINDOWS_MS;
+    at_timing_init(&up->done_timing, done_ms, done_ms, 2 * done_ms, 1);
+    // the module starts with full credit
+    up->credit_us = (uint64_t) config->dc_credit_ms * 1000;
+    up->refill_ms = now_ms;
+}
+
+uint32_t uplink_credit_us(uplink *up, uint32_t now_ms) {
+    uint64_t max_us = (uint64_t) up->config.dc_credit_ms * 1000;
+    up->credit_us += (uint64_t) (now_ms - up->refill_ms) * 1000 / UPLINK_DUTY_CYCLE;
+    up->refill_ms = now_ms;
+    if (up->credit_us > max_us) {
+        up->credit_us = max_us;
+    }
+    return (uint32_t) up->credit_us;
+}
+
+// True if an event of len bytes does not fit in the payload of the last queued event
+static bool uplink_starts_payload(const uplink *up, size_t len) {
+    return up->open_len == 0 || up->open_len + len > lora_max_payload(up->config.data_rate);
+}
+
+bool uplink_add(uplink *up, const uint8_t *event, size_t len, uint32_t now_ms) {
+    up->stats.events++;
+    if (len == 0 || len > lora_max_payload(up->config.data_rate) ||
+        up->event_count == UPLINK_MAX_EVENTS || up->data_len + len > UPLINK_BUFFER_SIZE) {
+        up->stats.dropped++;
+        return false;
+    }
+    bool first = uplink_starts_payload(up, len);
+    up->open_len = (first ? 0 : up->open_len) + len;
+    memcpy(up->data + up->data_len, event, len);
+    up->data_len += len;
+    up->event_len[up->event_count] = (uint16_t) len;
+    up->event_ms[up->event_count] = now_ms;
+    up->event_first[up->event_count] = first;
+    up->event_count++;
+    return true;
+}
+
+bool uplink_add_telemetry(uplink *up, telemetry_encoder *enc, const telemetry_event *event, uint32_t now_ms) {
+    uint8_t record[TELEMETRY_MAX_RECORD];
+    telemetry_encoder delta = *enc;
+    size_t len = telemetry_encode(&delta, event, record);
+    // an absolute record is never shorter, so it starts the payload as well
+    if (uplink_starts_payload(up, len)) {
+        telemetry_key(enc);
+        len = telemetry_encode(enc, event, record);
+    } else {
+        *enc = delta;
+    }
+    if (!uplink_add(up, record, len, now_ms)) {
+        // the next record can't be relative to one that is not sent
+        telemetry_key(enc);
+        return false;
+    }
+    return true;
+}
+
+// Removes the events of the uplink from the queue
+static void uplink_remove_frame(uplink *up, bool delivered) {
+    uint32_t now_ms = up->at->now_ms;
+    for (int i = 0; i < up->frame_events; i++) {
+        if (delivered) {
+            uint32_t latency = now_ms - up->event_ms[i];
+            up->stats.delivered++;
+            up->stats.latency_ms += latency;
+            if (latency > up->stats.max_latency_ms) {
+                up->stats.max_latency_ms = latency;
+            }
+        } else {
+            up->stats.dropped++;
+        }
+    }
+    memmove(up->data, up->data + up->frame_len, up->data_len - up->frame_len);
+    up->data_len -= up->frame_len;
+    up->event_count -= up->frame_events;
+    memmove(up->event_len, up->event_len + up->frame_events, up->event_count * sizeof(up->event_len[0]));
+    memmove(up->event_ms, up->event_ms + up->frame_events, up->event_count * sizeof(up->event_ms[0]));
+    memmove(up->event_first, up->event_first + up->frame_events, up->event_count * sizeof(up->event_first[0]));
+    up->frame_events = 0;
+    up->frame_len = 0;
+}
+
+static void uplink_on_done(at_status status, const at_record *rec, void *ctx) {
+    uplink *up = ctx;
+    // without Done the uplink has still gone out after Start
+    if (status != AT_STATUS_OK) {
+        up->stats.failed++;
+    }
+    up->stats.uplinks++;
+    up->stats.bytes += up->frame_len;
+    up->stats.airtime_us += up->frame_airtime_us;
+    uplink_remove_frame(up, true);
+    up->busy = false;
+}
+
+static void uplink_on_start(at_status status, const at_record *rec, void *ctx) {
+    uplink *up = ctx;
+    const char *value = rec->line + rec->value_offset;
+    size_t no_band_len = strlen(NO_BAND);
+    if (status == AT_STATUS_OK && rec->value_len == 5 && memcmp(value, "Start", 5) == 0) {
+        at_wait(up->at, "+MSGHEX: Done", &up->done_timing, uplink_on_done, up);
+        return;
+    }
+    up->busy = false;
+    if (status == AT_STATUS_OK && rec->value_len > no_band_len && memcmp(value, NO_BAND, no_band_len) == 0) {
+        // "No band in 13469 ms": credit is short by the airtime of 13469 ms of refill
+        size_t digits = 0;
+        while (no_band_len + digits < rec->value_len && value[no_band_len + digits] >= '0' &&
+               value[no_band_len + digits] <= '9') {
+            digits++;
+        }
+        int32_t wait_ms;
+        if (at_decode_int(value + no_band_len, digits, &wait_ms) && wait_ms >= 0) {
+            uint64_t missing_us = (uint64_t) wait_ms * 1000 / UPLINK_DUTY_CYCLE;
+            uplink_credit_us(up, up->at->now_ms);
+            up->credit_us = missing_us < up->frame_airtime_us ? up->frame_airtime_us - missing_us : 0;
+            up->hold = true;
+            up->hold_until_ms = up->at->now_ms + (uint32_t) wait_ms;
+        }
+        up->stats.refused++;
+        return;
+    }
+    up->stats.failed++;
+    if (status != AT_STATUS_OK) {
+        // no answer: the uplink may still have gone out, its events are dropped
+        uplink_remove_frame(up, false);
+        return;
+    }
+    // not joined or the payload was refused, nothing went out: try again later
+    up->hold = true;
+    up->hold_until_ms = up->at->now_ms + UPLINK_RETRY_MS;
+}
+
+void uplink_poll(uplink *up, uint32_t now_ms) {
+    // signed differences work across the 32-bit millisecond wrap
+    if (up->busy || up->event_count == 0 || (up->hold && (int32_t) (now_ms - up->hold_until_ms) < 0)) {
+        return;
+    }
+    up->hold = false;
+    bool full = up->data_len + up->event_len[up->event_count - 1] > up->config.flush_size;
+    if (!full && (int32_t) (now_ms - up->event_ms[0]) < (int32_t) up->config.max_age_ms) {
+        return;
+    }
+    // the events up to the next payload start, they fit in the payload
+    int events = 0;
+    size_t len = 0;
+    do {
+        len += up->event_len[events++];
+    } while (events < up->event_count && !up->event_first[events]);
+    uint32_t airtime = lora_airtime_us(up->config.data_rate, len);
+    if (up->config.dc_credit_ms) {
+        if (uplink_credit_us(up, now_ms) < airtime) {
+            return;
+        }
+        up->credit_us -= airtime;
+    }
+    memcpy(up->command, "AT+MSGHEX=\"", 11);
+    at_encode_hex(up->data, len, up->command + 11);
+    memcpy(up->command + 11 + 2 * len, "\"\r\n", 4);
+    if (!at_enqueue(up->at, up->command, "+MSGHEX: ", &up->start_timing, uplink_on_start, up)) {
+        up->credit_us += up->config.dc_credit_ms ? airtime : 0;
+        return;
+    }
+    up->busy = true;
+    up->frame_events = events;
+    up->frame_len = len;
+    up->frame_airtime_us = airtime;
+    if (events == up->event_count) {
+        // the payload is closed, events queued from now on go in the next one
+        up->open_len = 0;
+    }
+}
@@ -0,0 +1,96 @@
+// Uplink aggregator for AT+MSGHEX.
+//
+// Events are short byte strings, such as encoded sensor readings. They are queued and sent
+// together: an uplink carries as many whole events as fit in the maximum payload of the data
+// rate. Where a payload starts is decided when an event is queued and kept when the uplink
+// has to be sent again. An uplink goes out when another event of the size of the last one
+// would not fit in flush_size bytes or when the oldest event has waited max_age_ms.
+// Telemetry records (telemetry.h) are relative to the previous record, uplink_add_telemetry()
+// makes the first one of each payload absolute so that every uplink decodes on its own.
+//
+// Every uplink takes time on air that the duty cycle limit has to allow. The module keeps a
+// bucket of airtime credit that refills at 1 % of the elapsed time and refuses uplinks it
+// has no credit for. The aggregator keeps the same bucket and sends only when the module
+// will accept the uplink, events keep queueing in the meantime and go out together. If the
+// module refuses anyway (it kept its credit over a reset of the Pico), the bucket is synced
+// from the "No band in N ms" answer and nothing is sent for N ms.
+//
+// AT+MSGHEX answers Start, then Done after the receive windows. The uplink is sent through an
+// at_client and never resent after a lost answer, which may still mean that the uplink went
+// out: its events are dropped. An uplink the module refused (not joined, bad payload) is sent
+// again after UPLINK_RETRY_MS.
+
+#ifndef LAB03_UPLINK_H
+#define LAB03_UPLINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "at_client.h"
+#include "lora_airtime.h"
+#include "telemetry.h"
+
+#define UPLINK_BUFFER_SIZE 512
+#define UPLINK_MAX_EVENTS 64
+#define UPLINK_DUTY_CYCLE 100 // 1 %
+#define UPLINK_RX_WINDOWS_MS 3000 // RX1 and RX2 after the uplink, before Done
+#define UPLINK_RETRY_MS 10000 // wait after a refusal
+
+typedef struct {
+    uint8_t data_rate;      // EU868 DR0..DR5
+    size_t flush_size;      // payload size to fill before an uplink is due, 0: maximum payload of the data rate
+    uint32_t max_age_ms;    // age of the oldest event that makes an uplink due
+    uint32_t dc_credit_ms;  // largest duty cycle credit in airtime, 0: not tracked
+} uplink_config;
+
+typedef struct {
+    uint32_t events;        // queued
+    uint32_t dropped;       // did not fit in the queue or the uplink got no answer
+    uint32_t delivered;     // sent in an uplink that completed
+    uint32_t uplinks;
+    uint32_t refused;       // module had no duty cycle credit
+    uint32_t failed;        // no answer or an error
+    uint32_t bytes;
+    uint64_t airtime_us;
+    uint64_t latency_ms;    // sum over delivered events, from queueing to Done
+    uint32_t max_latency_ms;
+} uplink_stats;
+
+typedef struct {
+    at_client *at;
+    uplink_config config;
+    uplink_stats stats;
+    // queued events back to back
+    uint8_t data[UPLINK_BUFFER_SIZE];
+    size_t data_len;
+    uint16_t event_len[UPLINK_MAX_EVENTS];
+    uint32_t event_ms[UPLINK_MAX_EVENTS];   // when each event was queued
+    bool event_first[UPLINK_MAX_EVENTS];    // event starts a payload
+    int event_count;
+    size_t open_len;        // bytes in the payload of the last event, 0: the next event starts one
+    // uplink in progress, its events are the first ones in the queue
+    bool busy;
+    int frame_events;
+    size_t frame_len;
+    uint32_t frame_airtime_us;
+    bool hold;              // after a refusal or an error the next uplink waits until hold_until_ms
+    uint32_t hold_until_ms;
+    char command[2 * LORA_MAX_PAYLOAD + 16];
+    at_timing start_timing; // AT+MSGHEX to its first answer
+    at_timing done_timing;  // Start to Done
+    // duty cycle credit in airtime
+    uint64_t credit_us;
+    uint32_t refill_ms;     // credit has been added up to this time
+} uplink;
+
+void uplink_init(uplink *up, at_client *at, const uplink_config *config, uint32_t now_ms);
+// Queues an event, returns false if it is larger than the payload or does not fit in the queue
+bool uplink_add(uplink *up, const uint8_t *event, size_t len, uint32_t now_ms);
+// Encodes the event with enc and queues the record, absolute if it starts a payload
+bool uplink_add_telemetry(uplink *up, telemetry_encoder *enc, const telemetry_event *event, uint32_t now_ms);
+// Sends an uplink when one is due and the duty cycle allows it, call from the main loop
+void uplink_poll(uplink *up, uint32_t now_ms);
+// Duty cycle credit in airtime at now_ms
+uint32_t uplink_credit_us(uplink *up, uint32_t now_ms);
+
+#endif //LAB03_UPLINK_H
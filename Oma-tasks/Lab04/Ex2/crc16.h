@@ -0,0 +1,10 @@
+#ifndef LAB04_CRC16_H
+#define LAB04_CRC16_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-16/CCITT-FALSE. Running it over data followed by its CRC (MSB first) gives 0.
+uint16_t crc16(const uint8_t *data, size_t length);
+
+#endif // LAB04_CRC16_H
@@ -0,0 +1,86 @@
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include <string.h>
+#include "eeprom.h"
+
+static bool writeCycle = false; // A write cycle may still be running
+static uint64_t writeStartUs;
+
+bool eeprom_wait(void)
+{
+    if (!writeCycle)
+    {
+        return true;
+    }
+
+    // The RP2040 can't send an address without data, so poll with a one byte read.
+    // Every access sets its own address, so the read doesn't disturb anything.
+    uint8_t dummy;
+    while (i2c_read_blocking(i2c_default, EEPROM_ADDR, &dummy, 1, false) != 1)
+    {
+        if (time_us_64() - writeStartUs > EEPROM_WRITE_TIMEOUT_US)
+        {
+            writeCycle = false;
+            return false;
+        }
+    }
+    writeCycle = false;
+    return true;
+}
+
+bool eeprom_write(uint16_t addr, const uint8_t *buf, size_t len)
+{
+    if ((size_t)addr + len > EEPROM_SIZE)
+    {
+        return false;
+    }
+
+    uint8_t buffer[2 + EEPROM_PAGE_SIZE]; // 2 bytes for the address
+    while (len > 0)
+    {
+        // Up to the end of the page the address is in.
+        size_t chunk = EEPROM_PAGE_SIZE - addr % EEPROM_PAGE_SIZE;
+        if (chunk > len)
+        {
+            chunk = len;
+        }
+
+        buffer[0] = (uint8_t)(addr >> 8);
+        buffer[1] = (uint8_t)(addr & 0xFF);
+        memcpy(buffer + 2, buf, chunk);
+        if (!eeprom_wait() || i2c_write_blocking(i2c_default, EEPROM_ADDR, buffer, 2 + chunk, false) != (int)(2 + chunk))
+        {
+            return false;
+        }
+        writeCycle = true;
+        writeStartUs = time_us_64();
+
+        addr += chunk;
+        buf += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+bool eeprom_read(uint16_t addr, uint8_t *buf, size_t len)
+{
+    if ((size_t)addr + len > EEPROM_SIZE)
+    {
+        return false;
+    }
+    if (len == 0)
+    {
+        return true;
+    }
+
+    uint8_t addrBuffer[2];
+    addrBuffer[0] = (uint8_t)(addr >> 8);
+    addrBuffer[1] = (uint8_t)(addr & 0xFF);
+
+    // Address write without stop, then the whole range in one read.
+    if (!eeprom_wait() || i2c_write_blocking(i2c_default, EEPROM_ADDR, addrBuffer, 2, true) != 2)
+    {
+        return false;
+    }
+    return i2c_read_blocking(i2c_default, EEPROM_ADDR, buf, len, false) == (int)len;
+}
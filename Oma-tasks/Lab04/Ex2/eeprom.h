@@ -0,0 +1,32 @@
+// Driver for the AT24C256 I2C EEPROM.
+//
+// The chip writes at most one 64 byte page per transaction and wraps around inside the page
+// if more is sent, so writes are split on page boundaries: the first and last chunk may be
+// partial, everything in between is written as full pages. Reads have no such limit and
+// any range is read in one sequential transaction.
+// After a write the chip is busy for its internal write cycle (tWR, at most 5 ms) and doesn't
+// ACK its address. Instead of sleeping after each write, the next access polls the address
+// until the chip answers, so a write returns right away and only waits if the chip is
+// accessed again before the cycle is over.
+// The I2C bus (i2c_default) is set up by the caller.
+
+#ifndef LAB04_EEPROM_H
+#define LAB04_EEPROM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define EEPROM_ADDR 0x50 // I2C address of the EEPROM
+#define EEPROM_SIZE 32768
+#define EEPROM_PAGE_SIZE 64
+#define EEPROM_WRITE_TIMEOUT_US 10000 // Give up polling after twice the datasheet tWR
+
+// Writes len bytes starting at addr. Returns false if the range doesn't fit or the chip doesn't answer.
+bool eeprom_write(uint16_t addr, const uint8_t *buf, size_t len);
+// Reads len bytes starting at addr. Returns false if the range doesn't fit or the chip doesn't answer.
+bool eeprom_read(uint16_t addr, uint8_t *buf, size_t len);
+// Waits until the last write has been programmed. Returns false if the chip didn't answer in time.
+bool eeprom_wait(void);
+
+#endif // LAB04_EEPROM_H
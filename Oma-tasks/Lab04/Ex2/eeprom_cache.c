@@ -0,0 +1,208 @@
+#include "pico/stdlib.h"
+#include <string.h>
+#include "eeprom.h"
+#include "eeprom_cache.h"
+
+#define NO_PAGE 0xFFFF
+
+typedef struct cachePage
+{
+    uint16_t page; // Page number, NO_PAGE if the slot is free
+    uint8_t data[EEPROM_PAGE_SIZE];
+    uint8_t dirtyStart; // Dirty bytes are dirtyStart..dirtyEnd - 1
+    uint8_t dirtyEnd;   // 0 if the page is clean
+    uint64_t changedUs; // Time of the last change
+    uint32_t lastUse;
+} cachePage;
+
+static cachePage pages[EEPROM_CACHE_PAGES];
+static uint64_t stableUs;
+static uint32_t useCounter;
+static eepromCacheStats stats;
+
+void eeprom_cache_init(uint32_t stableMs)
+{
+    for (int i = 0; i < EEPROM_CACHE_PAGES; i++)
+    {
+        pages[i].page = NO_PAGE;
+        pages[i].dirtyEnd = 0;
+    }
+    stableUs = (uint64_t)stableMs * 1000;
+    useCounter = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+static bool flushPage(cachePage *slot)
+{
+    if (slot->dirtyEnd == 0)
+    {
+        return true;
+    }
+
+    // Only the changed bytes, they are always inside the page
+    uint16_t addr = slot->page * EEPROM_PAGE_SIZE + slot->dirtyStart;
+    size_t len = slot->dirtyEnd - slot->dirtyStart;
+    if (!eeprom_write(addr, slot->data + slot->dirtyStart, len))
+    {
+        return false;
+    }
+    slot->dirtyEnd = 0;
+    stats.flushes++;
+    stats.bytesWritten += len;
+    return true;
+}
+
+// Returns the slot holding the page, reading it from the EEPROM if it isn't cached
+static cachePage *getPage(uint16_t page)
+{
+    cachePage *victim = &pages[0];
+    for (int i = 0; i < EEPROM_CACHE_PAGES; i++)
+    {
+        if (pages[i].page == page)
+        {
+            stats.hits++;
+            pages[i].lastUse = ++useCounter;
+            return &pages[i];
+        }
+        // Prefer free slots, then the least recently used one
+        if (victim->page != NO_PAGE && (pages[i].page == NO_PAGE || pages[i].lastUse < victim->lastUse))
+        {
+            victim = &pages[i];
+        }
+    }
+
+    if (victim->page != NO_PAGE && !flushPage(victim))
+    {
+        return NULL;
+    }
+    victim->page = NO_PAGE;
+    if (!eeprom_read(page * EEPROM_PAGE_SIZE, victim->data, EEPROM_PAGE_SIZE))
+    {
+        return NULL;
+    }
+    stats.misses++;
+    victim->page = page;
+    victim->dirtyEnd = 0;
+    victim->lastUse = ++useCounter;
+    return victim;
+}
+
+bool eeprom_cache_read(uint16_t addr, uint8_t *buf, size_t len)
+{
+    if ((size_t)addr + len > EEPROM_SIZE)
+    {
+        return false;
+    }
+
+    while (len > 0)
+    {
+        size_t offset = addr % EEPROM_PAGE_SIZE;
+        size_t chunk = EEPROM_PAGE_SIZE - offset;
+        if (chunk > len)
+        {
+            chunk = len;
+        }
+
+        cachePage *slot = getPage(addr / EEPROM_PAGE_SIZE);
+        if (slot == NULL)
+        {
+            return false;
+        }
+        memcpy(buf, slot->data + offset, chunk);
+
+        addr += chunk;
+        buf += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+bool eeprom_cache_write(uint16_t addr, const uint8_t *buf, size_t len)
+{
+    if ((size_t)addr + len > EEPROM_SIZE)
+    {
+        return false;
+    }
+
+    while (len > 0)
+    {
+        size_t offset = addr % EEPROM_PAGE_SIZE;
+        size_t chunk = EEPROM_PAGE_SIZE - offset;
+        if (chunk > len)
+        {
+            chunk = len;
+        }
+
+        cachePage *slot = getPage(addr / EEPROM_PAGE_SIZE);
+        if (slot == NULL)
+        {
+            return false;
+        }
+        if (memcmp(slot->data + offset, buf, chunk) != 0)
+        {
+            memcpy(slot->data + offset, buf, chunk);
+            if (slot->dirtyEnd == 0)
+            {
+                slot->dirtyStart = offset;
+                slot->dirtyEnd = offset + chunk;
+            }
+            else
+            {
+                if (offset < slot->dirtyStart)
+                {
+                    slot->dirtyStart = offset;
+                }
+                if (offset + chunk > slot->dirtyEnd)
+                {
+                    slot->dirtyEnd = offset + chunk;
+                }
+            }
+            slot->changedUs = time_us_64();
+        }
+
+        addr += chunk;
+        buf += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+void eeprom_cache_poll(void)
+{
+    uint64_t now = time_us_64();
+    for (int i = 0; i < EEPROM_CACHE_PAGES; i++)
+    {
+        if (pages[i].dirtyEnd != 0 && now - pages[i].changedUs >= stableUs)
+        {
+            flushPage(&pages[i]);
+        }
+    }
+}
+
+bool eeprom_cache_sync(void)
+{
+    bool ok = true;
+    for (int i = 0; i < EEPROM_CACHE_PAGES; i++)
+    {
+        ok &= flushPage(&pages[i]);
+    }
+    return eeprom_wait() && ok;
+}
+
+bool eeprom_cache_dirty(uint16_t addr, size_t len)
+{
+    size_t offset = addr % EEPROM_PAGE_SIZE;
+    for (int i = 0; i < EEPROM_CACHE_PAGES; i++)
+    {
+        if (pages[i].page == addr / EEPROM_PAGE_SIZE)
+        {
+            return pages[i].dirtyEnd != 0 && offset >= pages[i].dirtyStart && offset + len <= pages[i].dirtyEnd;
+        }
+    }
+    return false;
+}
+
+const eepromCacheStats *eeprom_cache_stats(void)
+{
+    return &stats;
+}
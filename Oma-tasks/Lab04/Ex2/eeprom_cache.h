@@ -0,0 +1,39 @@
+// Write-back RAM cache in front of the EEPROM driver.
+//
+// The cache holds whole 64 byte pages. A write only changes the cached copy and marks the
+// changed bytes dirty, writing the same value again changes nothing. A dirty page is written
+// to the EEPROM once it hasn't changed for the stable time given to eeprom_cache_init(), or
+// when eeprom_cache_sync() is called, so a burst of updates costs one page write.
+// eeprom_cache_poll() has to be called regularly, e.g. from the main loop.
+//
+// Access a page either through the cache or directly through eeprom.h, not both.
+
+#ifndef LAB04_EEPROM_CACHE_H
+#define LAB04_EEPROM_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define EEPROM_CACHE_PAGES 4
+
+typedef struct eepromCacheStats
+{
+    uint32_t hits;         // Page accesses served from RAM
+    uint32_t misses;       // Pages read from the EEPROM
+    uint32_t flushes;      // Page writes to the EEPROM
+    uint32_t bytesWritten; // Data bytes written to the EEPROM
+} eepromCacheStats;
+
+void eeprom_cache_init(uint32_t stableMs);
+bool eeprom_cache_read(uint16_t addr, uint8_t *buf, size_t len);
+bool eeprom_cache_write(uint16_t addr, const uint8_t *buf, size_t len);
+// Writes pages that have been dirty and unchanged for the stable time
+void eeprom_cache_poll(void);
+// Writes all dirty pages and waits until the EEPROM has programmed them
+bool eeprom_cache_sync(void);
+// True if all of the range is cached and changed but not yet written to the EEPROM
+bool eeprom_cache_dirty(uint16_t addr, size_t len);
+const eepromCacheStats *eeprom_cache_stats(void);
+
+#endif // LAB04_EEPROM_CACHE_H
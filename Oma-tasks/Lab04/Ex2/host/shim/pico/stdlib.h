@@ -0,0 +1,15 @@
+//
+// Host replacement for the parts of pico/stdlib.h that the EEPROM modules use.
+// Time is simulated and only moves when the test calls sim_advance_us() (see sim_eeprom.h).
+//
+
+#ifndef LAB04_HOST_PICO_STDLIB_H
+#define LAB04_HOST_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+uint64_t time_us_64(void);
+
+#endif //LAB04_HOST_PICO_STDLIB_H
@@ -0,0 +1,95 @@
+//
+// Simulated AT24C256, see sim_eeprom.h
+//
+#include <string.h>
+#include "pico/stdlib.h"
+#include "sim_eeprom.h"
+
+uint8_t sim_image[EEPROM_SIZE];
+
+static long cutAfter = -1;
+static bool powered = true;
+static long written;
+static uint64_t nowUs;
+
+uint64_t time_us_64(void)
+{
+    return nowUs;
+}
+
+void sim_advance_us(uint64_t us)
+{
+    nowUs += us;
+}
+
+void sim_cut_after(long n)
+{
+    cutAfter = n;
+}
+
+bool sim_powered(void)
+{
+    return powered;
+}
+
+void sim_power_on(void)
+{
+    powered = true;
+    cutAfter = -1;
+    written = 0;
+}
+
+long sim_bytes_written(void)
+{
+    return written;
+}
+
+bool eeprom_write(uint16_t addr, const uint8_t *buf, size_t len)
+{
+    if (!powered || addr + len > EEPROM_SIZE)
+    {
+        return false;
+    }
+    // The driver splits writes on page boundaries, one call here is one or more page writes
+    size_t done = 0;
+    while (done < len)
+    {
+        size_t chunk = EEPROM_PAGE_SIZE - (addr + done) % EEPROM_PAGE_SIZE;
+        if (chunk > len - done)
+        {
+            chunk = len - done;
+        }
+        for (size_t i = 0; i < chunk; i++)
+        {
+            if (cutAfter >= 0 && written == cutAfter)
+            {
+                // Every bit wrong. Random bytes would now and then pass the CRC-16 of a record.
+                for (; i < chunk; i++)
+                {
+                    sim_image[addr + done + i] = ~buf[done + i];
+                }
+                powered = false;
+                return false;
+            }
+            sim_image[addr + done + i] = buf[done + i];
+            written++;
+        }
+        done += chunk;
+    }
+    return true;
+}
+
+bool eeprom_read(uint16_t addr, uint8_t *buf, size_t len)
+{
+    if (!powered || addr + len > EEPROM_SIZE)
+    {
+        return false;
+    }
+    memcpy(buf, sim_image + addr, len);
+    return true;
+}
+
+bool eeprom_wait(void)
+{
+    return powered;
+}
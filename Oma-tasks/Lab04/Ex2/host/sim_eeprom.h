@@ -0,0 +1,27 @@
+//
+// Simulated AT24C256 behind the eeprom.h interface, with power cuts.
+//
+// The contents live in a RAM image. sim_cut_after(n) lets n more bytes be written and cuts
+// the power on the next one. The chip is programming the rest of that page write when the
+// power goes, so the bytes from the cut to the end of the write are left wrong. Everything
+// after that fails until sim_power_on().
+//
+
+#ifndef LAB04_HOST_SIM_EEPROM_H
+#define LAB04_HOST_SIM_EEPROM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "eeprom.h"
+
+extern uint8_t sim_image[EEPROM_SIZE];
+
+// Cuts the power after n more bytes, -1 never
+void sim_cut_after(long n);
+bool sim_powered(void);
+void sim_power_on(void);
+// Bytes written since the last sim_power_on()
+long sim_bytes_written(void);
+void sim_advance_us(uint64_t us);
+
+#endif //LAB04_HOST_SIM_EEPROM_H
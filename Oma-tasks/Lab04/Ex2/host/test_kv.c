@@ -0,0 +1,211 @@
+//
+// Power cut test of the key-value store (kv.h) against a simulated EEPROM.
+//
+// usage: test_kv [steps] [seeds]
+//   steps  puts per run (default 400), enough for the log to go round the area three times
+//   seeds  workloads to run, seeded 1..seeds (default 8)
+//
+// A workload of puts, mostly to one key, runs with the cache flushing in the background and
+// a sync every SYNC_EVERY puts. It is run once to count the bytes it writes and then once for
+// every byte with the power cut there, which covers every page write the store makes, the
+// carried forward records included. After each cut the store is initialised from the EEPROM
+// again and every key must have its value at the last completed sync or one put after it.
+// A put that fails before the cut must leave the value kv_get() returns as it was.
+// A put to every key must then survive another restart. Exits with 1 on the first failure.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "eeprom_cache.h"
+#include "kv.h"
+#include "sim_eeprom.h"
+
+#define SYNC_EVERY 16
+#define STEP_US 1500 // Longer than the stable time, a quarter of it is not
+#define STABLE_MS 1
+#define MAX_ALLOWED (SYNC_EVERY + 2)
+
+typedef struct value
+{
+    uint8_t len; // 0 if not stored
+    uint8_t data[KV_MAX_VALUE];
+} value;
+
+// Values a key may have after a restart
+typedef struct allowed
+{
+    value values[MAX_ALLOWED];
+    int count;
+} allowed;
+
+static allowed model[KV_MAX_KEYS];
+static uint32_t rng;
+
+static uint32_t nextRandom(void)
+{
+    // xorshift32, the low bits of an LCG would tie the key to the value
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static void restart(void)
+{
+    sim_power_on();
+    eeprom_cache_init(STABLE_MS);
+    kv_init();
+}
+
+static value current(uint8_t key)
+{
+    value v = {0};
+    int len = kv_get(key, v.data, sizeof(v.data));
+    v.len = len < 0 ? 0 : len;
+    return v;
+}
+
+static bool sameValue(const value *a, const value *b)
+{
+    return a->len == b->len && memcmp(a->data, b->data, a->len) == 0;
+}
+
+// Only the value in RAM now can be on the EEPROM after a restart
+static void commit(void)
+{
+    for (uint8_t k = 0; k < KV_MAX_KEYS; k++)
+    {
+        model[k].values[0] = current(k);
+        model[k].count = 1;
+    }
+}
+
+// Runs the workload, stops when the power goes. Returns false if a failed put changed a value.
+static bool workload(int steps, uint32_t seed)
+{
+    rng = seed;
+    commit();
+    for (int i = 0; i < steps && sim_powered(); i++)
+    {
+        uint8_t key = nextRandom() % 4 == 0 ? nextRandom() % KV_MAX_KEYS : 0;
+        value v;
+        v.len = 1 + nextRandom() % KV_MAX_VALUE;
+        for (int b = 0; b < v.len; b++)
+        {
+            v.data[b] = nextRandom();
+        }
+        // The record may reach the EEPROM even if the put fails after writing it
+        model[key].values[model[key].count++] = v;
+        value before = current(key);
+        if (!kv_put(key, v.data, v.len))
+        {
+            value after = current(key);
+            if (!sameValue(&before, &after))
+            {
+                printf("failed put to key %d changed its value\n", key);
+                return false;
+            }
+        }
+
+        sim_advance_us(nextRandom() % 2 ? STEP_US : STEP_US / 4);
+        eeprom_cache_poll();
+        if ((i + 1) % SYNC_EVERY == 0 && eeprom_cache_sync() && sim_powered())
+        {
+            commit();
+        }
+    }
+    return true;
+}
+
+static bool check(long cut)
+{
+    for (uint8_t k = 0; k < KV_MAX_KEYS; k++)
+    {
+        value v = current(k);
+        int a = 0;
+        while (a < model[k].count && !sameValue(&v, &model[k].values[a]))
+        {
+            a++;
+        }
+        if (a == model[k].count)
+        {
+            printf("cut at byte %ld: key %d has a value it never had or lost a synced one (len %d)\n",
+                   cut, k, v.len);
+            return false;
+        }
+    }
+
+    // The store must still work from what was recovered
+    uint8_t data[KV_MAX_VALUE];
+    for (uint8_t k = 0; k < KV_MAX_KEYS; k++)
+    {
+        memset(data, 0xA0 + k, sizeof(data));
+        if (!kv_put(k, data, 1 + k % KV_MAX_VALUE))
+        {
+            printf("cut at byte %ld: put to key %d failed after restart\n", cut, k);
+            return false;
+        }
+    }
+    eeprom_cache_sync();
+    restart();
+    for (uint8_t k = 0; k < KV_MAX_KEYS; k++)
+    {
+        value v = current(k);
+        memset(data, 0xA0 + k, sizeof(data));
+        if (v.len != 1 + k % KV_MAX_VALUE || memcmp(v.data, data, v.len) != 0)
+        {
+            printf("cut at byte %ld: key %d lost its value after the second restart\n", cut, k);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool run(int steps, uint32_t seed)
+{
+    memset(sim_image, 0xFF, sizeof(sim_image));
+    restart();
+    if (!workload(steps, seed))
+    {
+        return false;
+    }
+    long total = sim_bytes_written();
+    const eepromCacheStats *stats = eeprom_cache_stats();
+    printf("seed %lu: %d puts, %lu page writes, %ld bytes written\n",
+           (unsigned long)seed, steps, (unsigned long)stats->flushes, total);
+
+    for (long cut = 0; cut < total; cut++)
+    {
+        memset(sim_image, 0xFF, sizeof(sim_image));
+        restart();
+        sim_cut_after(cut);
+        if (!workload(steps, seed))
+        {
+            printf("cut at byte %ld\n", cut);
+            return false;
+        }
+        restart();
+        if (!check(cut))
+        {
+            return false;
+        }
+    }
+    printf("seed %lu: power cut at each of %ld bytes: ok\n", (unsigned long)seed, total);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int steps = argc > 1 ? atoi(argv[1]) : 400;
+    int seeds = argc > 2 ? atoi(argv[2]) : 8;
+
+    for (int seed = 1; seed <= seeds; seed++)
+    {
+        if (!run(steps, seed))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include <string.h>
+#include "eeprom.h"
+#include "eeprom_cache.h"
+#include "crc16.h"
+#include "kv.h"
+
+// Record: key, length, sequence number (4 bytes), value (8 bytes), CRC-16 over the rest
+#define RECORD_SIZE 16
+#define RECORD_CRC 14
+#define RECORDS_PER_PAGE (EEPROM_PAGE_SIZE / RECORD_SIZE)
+#define KV_SLOTS (KV_PAGES * RECORDS_PER_PAGE)
+
+typedef struct kvEntry
+{
+    bool stored;
+    uint8_t len;
+    uint8_t value[KV_MAX_VALUE];
+    uint16_t slot; // Where the newest record is
+    uint32_t seq;
+} kvEntry;
+
+static kvEntry entries[KV_MAX_KEYS];
+static uint16_t head; // Next slot to write
+static uint32_t lastSeq;
+
+static uint16_t slotAddr(uint16_t slot)
+{
+    return KV_START_ADDR + slot * RECORD_SIZE;
+}
+
+static bool parseRecord(const uint8_t *record, uint8_t *key, uint32_t *seq)
+{
+    if (crc16(record, RECORD_SIZE) != 0 || record[0] >= KV_MAX_KEYS || record[1] == 0 || record[1] > KV_MAX_VALUE)
+    {
+        return false;
+    }
+    *key = record[0];
+    *seq = (uint32_t)record[2] << 24 | (uint32_t)record[3] << 16 | (uint32_t)record[4] << 8 | record[5];
+    return true;
+}
+
+void kv_init(void)
+{
+    memset(entries, 0, sizeof(entries));
+    head = 0;
+    lastSeq = 0;
+
+    // The cache is still empty, so the area is read page by page past it.
+    uint8_t page[EEPROM_PAGE_SIZE];
+    for (uint16_t p = 0; p < KV_PAGES; p++)
+    {
+        if (!eeprom_read(KV_START_ADDR + p * EEPROM_PAGE_SIZE, page, EEPROM_PAGE_SIZE))
+        {
+            continue;
+        }
+        for (int r = 0; r < RECORDS_PER_PAGE; r++)
+        {
+            const uint8_t *record = page + r * RECORD_SIZE;
+            uint8_t key;
+            uint32_t seq;
+            if (!parseRecord(record, &key, &seq))
+            {
+                continue;
+            }
+
+            uint16_t slot = p * RECORDS_PER_PAGE + r;
+            kvEntry *entry = &entries[key];
+            if (!entry->stored || seq > entry->seq)
+            {
+                entry->stored = true;
+                entry->len = record[1];
+                memcpy(entry->value, record + 6, entry->len);
+                entry->slot = slot;
+                entry->seq = seq;
+            }
+            if (seq > lastSeq)
+            {
+                lastSeq = seq;
+                head = (slot + 1) % KV_SLOTS;
+            }
+        }
+    }
+}
+
+int kv_get(uint8_t key, uint8_t *value, size_t size)
+{
+    if (key >= KV_MAX_KEYS || !entries[key].stored || entries[key].len > size)
+    {
+        return -1;
+    }
+    memcpy(value, entries[key].value, entries[key].len);
+    return entries[key].len;
+}
+
+// Writes the value of entry with a new sequence number to slot as the record of key
+static bool writeRecord(uint8_t key, kvEntry *entry, uint16_t slot)
+{
+    uint8_t record[RECORD_SIZE];
+    memset(record, 0xFF, sizeof(record));
+    record[0] = key;
+    record[1] = entry->len;
+    uint32_t seq = lastSeq + 1;
+    record[2] = seq >> 24;
+    record[3] = seq >> 16;
+    record[4] = seq >> 8;
+    record[5] = seq & 0xFF;
+    memcpy(record + 6, entry->value, entry->len);
+    uint16_t crc = crc16(record, RECORD_CRC);
+    record[RECORD_CRC] = crc >> 8;
+    record[RECORD_CRC + 1] = crc & 0xFF;
+
+    if (!eeprom_cache_write(slotAddr(slot), record, RECORD_SIZE))
+    {
+        return false;
+    }
+    lastSeq = seq;
+    entry->slot = slot;
+    entry->seq = seq;
+    return true;
+}
+
+// True if the page holds the newest record of a key
+static bool pageInUse(uint16_t page)
+{
+    for (uint8_t k = 0; k < KV_MAX_KEYS; k++)
+    {
+        if (entries[k].stored && entries[k].slot / RECORDS_PER_PAGE == page)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool appendRecord(uint8_t key, kvEntry *entry)
+{
+    if (!writeRecord(key, entry, head))
+    {
+        return false;
+    }
+    head = (head + 1) % KV_SLOTS;
+    return true;
+}
+
+bool kv_put(uint8_t key, const uint8_t *value, size_t len)
+{
+    if (key >= KV_MAX_KEYS || len == 0 || len > KV_MAX_VALUE)
+    {
+        return false;
+    }
+    kvEntry *entry = &entries[key];
+    if (entry->stored && entry->len == len && memcmp(entry->value, value, len) == 0)
+    {
+        return true;
+    }
+
+    // The index keeps the old value until the new record is written, so a failed put leaves
+    // kv_get() returning what is on the EEPROM and a key never stored pins no page.
+    kvEntry update = *entry;
+    update.stored = true;
+    update.len = len;
+    memcpy(update.value, value, len);
+
+    // Replacing the newest record before it has reached the EEPROM costs nothing.
+    uint16_t newest = (head + KV_SLOTS - 1) % KV_SLOTS;
+    if (entry->stored && entry->slot == newest && eeprom_cache_dirty(slotAddr(newest), RECORD_SIZE))
+    {
+        if (!writeRecord(key, &update, newest))
+        {
+            return false;
+        }
+        *entry = update;
+        return true;
+    }
+
+    // Starting a page. Everything written so far is made durable first, so every key's newest
+    // record in the index is also on the EEPROM. A page holding one of them is never written,
+    // the head skips to the next page without any. There always is one, there are more pages
+    // than keys. The records still in use in the page after it are copied here, which frees
+    // that page for the next time. Their old copies are only overwritten after the next sync.
+    // The key being written isn't copied, its new record follows. Its old record still keeps
+    // its own page from being written until the new one is in place.
+    // If the copies fill the page, the next one is started the same way.
+    while (head % RECORDS_PER_PAGE == 0)
+    {
+        if (!eeprom_cache_sync())
+        {
+            return false;
+        }
+        uint16_t page = head / RECORDS_PER_PAGE;
+        while (pageInUse(page))
+        {
+            page = (page + 1) % KV_PAGES;
+        }
+        head = page * RECORDS_PER_PAGE;
+
+        uint16_t next = (page + 1) % KV_PAGES;
+        int moved = 0;
+        for (uint8_t k = 0; k < KV_MAX_KEYS; k++)
+        {
+            if (k != key && entries[k].stored && entries[k].slot / RECORDS_PER_PAGE == next)
+            {
+                if (!appendRecord(k, &entries[k]))
+                {
+                    return false;
+                }
+                moved++;
+            }
+        }
+        if (moved < RECORDS_PER_PAGE)
+        {
+            break;
+        }
+    }
+
+    if (!appendRecord(key, &update))
+    {
+        return false;
+    }
+    *entry = update;
+    return true;
+}
@@ -0,0 +1,36 @@
+// Key-value store for settings, kept as a log of records in a reserved EEPROM area.
+//
+// Every kv_put() appends a record (key, sequence number, value, CRC-16) at the head of the
+// log, which goes round the area one page after another, so each setting wears all of the
+// area instead of one cell. The newest valid record of a key wins.
+//
+// A page is only written when it holds no key's newest record, so a power cut during a write
+// (which can spoil the bytes of that page write) never takes the last copy of a value. When
+// the head starts a page, the records still in use in the page after it are copied there and
+// that page is reused only after the copies have been synced. A page holding newest records
+// is skipped. See host/test_kv.c for the power cut test.
+//
+// kv_init() reads the area once and keeps every key's value in RAM, kv_get() never touches
+// the EEPROM. Records are written through the write-back cache (eeprom_cache.h), a put that
+// replaces the record just appended and not yet flushed reuses its slot.
+
+#ifndef LAB04_KV_H
+#define LAB04_KV_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define KV_START_ADDR 4096 // After the log area, before the Lab03 settings
+#define KV_PAGES 32
+#define KV_MAX_KEYS 8
+#define KV_MAX_VALUE 8
+
+// Builds the index from the EEPROM. Call after eeprom_cache_init() and before any kv_put().
+void kv_init(void);
+// Copies the value of key to value, returns its length or -1 if the key isn't stored or doesn't fit
+int kv_get(uint8_t key, uint8_t *value, size_t size);
+// Returns false if key or len is out of range or the EEPROM doesn't answer
+bool kv_put(uint8_t key, const uint8_t *value, size_t len);
+
+#endif // LAB04_KV_H
@@ -3,6 +3,10 @@
 #include "hardware/i2c.h"
 #include "hardware/gpio.h"
 #include "pico/util/queue.h"
+#include "eeprom.h"
+#include "eeprom_cache.h"
+#include "crc16.h"
+#include "kv.h"
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
@@ -23,11 +27,9 @@
 #define LED_BRIGHT_MIN 0
 #define LED_BRIGHT_STEP 10
 
-#define EEPROM_ADDR 0x50 // I2C address of the EEPROM
-#define EEPROM_WRITE_DELAY_MS 5
-#define BRIGHTNESS_ADDR 30000
-#define LED_STATE_ADDR 32767 // Address in the EEPROM to store the LED state
-#define INVERSE_LED_ADDR 31000
+#define KV_KEY_LED_STATE 0 // LED state and its inverse
+#define KV_KEY_BRIGHTNESS 1
+#define EEPROM_CACHE_STABLE_MS 1000 // Settings are written once they haven't changed for this long
 #define BUFFER_SIZE 512
 #define HEX_MID_VALUE 32768
 
@@ -57,10 +59,11 @@ void defaultLedStatus(struct ledStatus *ledStatusStruct);
 void readBrightnessFromEeprom(struct ledStatus *ledStatusStruct);
 void handleCommands();
 void printLog(const uint8_t *logBuffer, int logBufferLen, int logEntryToRead);
-void appendAddrToString(const uint8_t *string, int *stringLen, uint8_t *finalArray, int address);
 void enterLogToEeprom(const char *string, int stringLen);
+void findLogHead();
 
 static queue_t irqEvents;
+static int logHead = 0; // First unused log entry, entries before it are valid
 
 int main()
 {
@@ -76,6 +79,8 @@ int main()
     gpio_set_function(SCL_PIN, GPIO_FUNC_I2C);
     gpio_pull_up(SDA_PIN);
     gpio_pull_up(SCL_PIN);
+    eeprom_cache_init(EEPROM_CACHE_STABLE_MS);
+    kv_init();
 
     // setup button pin for increase.
     gpio_init(ROT_A);
@@ -139,6 +144,7 @@ int main()
     char logstring[MAX_LOG_LEN];
 
     // Enter "Boot" to log.
+    findLogHead();
     enterLogToEeprom("Boot", 4);
 
     while (true)
@@ -149,6 +155,9 @@ int main()
             handleCommands();
         }
 
+        // Write settings that have settled.
+        eeprom_cache_poll();
+
         while (queue_try_remove(&irqEvents, &value))
         {
             // breakout in case queue contains consecutive interrupts.
@@ -375,56 +384,24 @@ void defaultLedStatus(struct ledStatus *ledStatusStruct)
 
 void writeLedStateToEeprom(const struct ledStatus *ledStatusStruct)
 {
-    uint16_t ledStatusAddress = LED_STATE_ADDR; // 3 bytes for the brightness
-    uint16_t inverseLedStatusAddress = INVERSE_LED_ADDR;
-
     uint8_t ledStatusDataByte = (ledStatusStruct->ledState[0] << 2) | (ledStatusStruct->ledState[1] << 1) | ledStatusStruct->ledState[2];
     uint8_t inverseLedStatusDataByte = (!ledStatusStruct->ledState[0] << 2) | (!ledStatusStruct->ledState[1] << 1) | !ledStatusStruct->ledState[2];
 
-    // Creating buffer to write to EEPROM
-    uint8_t buffer[3];
-    buffer[0] = (uint8_t)(ledStatusAddress >> 8);
-    buffer[1] = (uint8_t)(ledStatusAddress & 0xFF);
-    buffer[2] = ledStatusDataByte;
-
-    // Writing LED state to EEPROM
-    i2c_write_blocking(i2c_default, EEPROM_ADDR, buffer, 3, false);
-    sleep_ms(EEPROM_WRITE_DELAY_MS);
-
-    buffer[0] = (uint8_t)(inverseLedStatusAddress >> 8);
-    buffer[1] = (uint8_t)(inverseLedStatusAddress & 0xFF);
-    buffer[2] = inverseLedStatusDataByte;
-
-    // Writing inverse LED state to EEPROM
-    i2c_write_blocking(i2c_default, EEPROM_ADDR, buffer, 3, false);
-    sleep_ms(EEPROM_WRITE_DELAY_MS);
+    // Writing LED state and its inverse to EEPROM
+    uint8_t buffer[2] = {ledStatusDataByte, inverseLedStatusDataByte};
+    kv_put(KV_KEY_LED_STATE, buffer, 2);
 }
 
 bool readLedStateFromEeprom(struct ledStatus *ledStatusStruct)
 {
-    uint16_t ledStatusAddress = LED_STATE_ADDR; // 3 bytes for the brightness
-    uint16_t inverseLedStatusAddress = INVERSE_LED_ADDR;
-
-    uint8_t ledStatusDataByte;
-    uint8_t inverseLedStatusDataByte;
-
-    // Creating buffer to hold data address
+    // Reading LED state and its inverse from EEPROM
     uint8_t buffer[2];
-    buffer[0] = (uint8_t)(ledStatusAddress >> 8);
-    buffer[1] = (uint8_t)(ledStatusAddress & 0xFF);
-
-    // Reading LED state from EEPROM
-    i2c_write_blocking(i2c_default, EEPROM_ADDR, buffer, 2, true);
-    sleep_ms(EEPROM_WRITE_DELAY_MS);
-    i2c_read_blocking(i2c_default, EEPROM_ADDR, &ledStatusDataByte, 1, false);
-
-    buffer[0] = (uint8_t)(inverseLedStatusAddress >> 8);
-    buffer[1] = (uint8_t)(inverseLedStatusAddress & 0xFF);
-
-    // Reading inverse LED state from EEPROM
-    i2c_write_blocking(i2c_default, EEPROM_ADDR, buffer, 2, true);
-    sleep_ms(EEPROM_WRITE_DELAY_MS);
-    i2c_read_blocking(i2c_default, EEPROM_ADDR, &inverseLedStatusDataByte, 1, false);
+    if (kv_get(KV_KEY_LED_STATE, buffer, 2) != 2)
+    {
+        return false;
+    }
+    uint8_t ledStatusDataByte = buffer[0];
+    uint8_t inverseLedStatusDataByte = buffer[1];
 
     // Extract the LED state from the data byte
     int unpackedLedState[3];
@@ -459,34 +436,21 @@ bool readLedStateFromEeprom(struct ledStatus *ledStatusStruct)
 
 void writeBrightnessToEeprom(const struct ledStatus *ledStatusStruct)
 {
-    uint16_t brightnessAddress = BRIGHTNESS_ADDR;
-
     uint16_t brightnessDataByte = (uint16_t)ledStatusStruct->brightness;
 
-    uint8_t buffer[4];
-    buffer[0] = (uint8_t)(brightnessAddress >> 8);
-    buffer[1] = (uint8_t)(brightnessAddress & 0xFF);
-    buffer[2] = (uint8_t)(brightnessDataByte >> 8);
-    buffer[3] = (uint8_t)(brightnessDataByte & 0xFF);
+    uint8_t buffer[2];
+    buffer[0] = (uint8_t)(brightnessDataByte >> 8);
+    buffer[1] = (uint8_t)(brightnessDataByte & 0xFF);
 
-    i2c_write_blocking(i2c_default, EEPROM_ADDR, buffer, 4, false);
-    sleep_ms(EEPROM_WRITE_DELAY_MS);
+    kv_put(KV_KEY_BRIGHTNESS, buffer, 2);
 }
 
 void readBrightnessFromEeprom(struct ledStatus *ledStatusStruct)
 {
-    uint16_t brightnessAddress = BRIGHTNESS_ADDR;
-
     uint16_t brightnessDataByte;
 
-    // Filling buffer with brightness address
-    uint8_t buffer[2];
-    buffer[0] = (uint8_t)(brightnessAddress >> 8);
-    buffer[1] = (uint8_t)(brightnessAddress & 0xFF);
-
-    i2c_write_blocking(i2c_default, EEPROM_ADDR, buffer, 2, true);
-    sleep_ms(EEPROM_WRITE_DELAY_MS);
-    i2c_read_blocking(i2c_default, EEPROM_ADDR, buffer, 2, false); // Fills buffer with brightness data
+    uint8_t buffer[2] = {0xFF, 0xFF}; // Out of range if the key isn't stored
+    kv_get(KV_KEY_BRIGHTNESS, buffer, 2);
 
     brightnessDataByte = (buffer[0] << 8) | buffer[1];
 
@@ -500,21 +464,6 @@ void readBrightnessFromEeprom(struct ledStatus *ledStatusStruct)
 }
 
 // Ex2 stuff
-uint16_t crc16(const uint8_t *data, size_t length)
-{
-    uint8_t x;
-    uint16_t crc = 0xFFFF;
-
-    while (length--)
-    {
-        x = crc >> 8 ^ *data++;
-        x ^= x >> 4;
-        crc = (crc << 8) ^ ((uint16_t)(x << 12)) ^ ((uint16_t)(x << 5)) ^ ((uint16_t)x);
-    }
-
-    return crc;
-}
-
 // Creates a string with base 8 representation of the given string
 void convertStringToBase8(const char *string, const int stringLen, uint8_t *base8String)
 {
@@ -569,21 +518,16 @@ int readLogFromEeprom(const int logEntryToRead, uint8_t *logBuffer, const int lo
 {
     int logStartAddr = LOG_START_ADDR + (logEntryToRead * LOG_SIZE);
 
-    if (logStartAddr > LOG_END_ADDR || logStartAddr < LOG_START_ADDR || logBufferLen != LOG_SIZE)
+    if (logStartAddr + LOG_SIZE > LOG_END_ADDR || logStartAddr < LOG_START_ADDR || logBufferLen != LOG_SIZE)
     {
         return -1;
     }
 
-    // Log start address buffer
-    uint8_t logStartAddrBuffer[2];
-    logStartAddrBuffer[0] = logStartAddr >> 8;
-    logStartAddrBuffer[1] = logStartAddr & 0xFF;
-
     // Read log from EEPROM
-    i2c_write_blocking(i2c_default, EEPROM_ADDR, logStartAddrBuffer, 2, true);
-    sleep_ms(EEPROM_WRITE_DELAY_MS);
-    i2c_read_blocking(i2c_default, EEPROM_ADDR, logBuffer, LOG_SIZE, false);
-    sleep_ms(EEPROM_WRITE_DELAY_MS);
+    if (!eeprom_read(logStartAddr, logBuffer, LOG_SIZE))
+    {
+        return -1;
+    }
 
     return 0;
 }
@@ -594,30 +538,32 @@ void zeroAllLogs()
     int count = 0;
     uint16_t logAddr = 0;
 
-    uint8_t buffer[3] = {0, 0, 0};
-    while (count <= 32)
+    uint8_t zero = 0;
+    while (count < MAX_LOGS)
     {
-        buffer[0] = logAddr >> 8;
-        buffer[1] = logAddr & 0xFF;
-        i2c_write_blocking(i2c_default, EEPROM_ADDR, buffer, 3, false);
-        sleep_ms(EEPROM_WRITE_DELAY_MS);
+        eeprom_write(logAddr, &zero, 1);
         logAddr += LOG_SIZE;
         count++;
     }
+    logHead = 0;
     printf("Logs cleared\n");
 }
 
 void handleCommands()
 {
     sleep_ms(100); // Wait for the command to be fully received
-    uint8_t buffer[5];
+    uint8_t buffer[5] = {0};
     char uartread[5];
 
     int index = 0;
     while (uart_is_readable(uart0))
     {
-        buffer[index] = uart_getc(uart0);
-        index++;
+        uint8_t c = uart_getc(uart0);
+        if (index < 5) // Commands are at most 5 characters, drop the line end
+        {
+            buffer[index] = c;
+            index++;
+        }
     }
 
     int tempLen = LOG_SIZE;
@@ -632,7 +578,7 @@ void handleCommands()
     {
         printf("Printing all logs\n");
         uint8_t logBuffer[LOG_SIZE];
-        for (int i = 0; i < MAX_LOGS; i++)
+        for (int i = 0; i < logHead; i++) // Entries after logHead are empty
         {
             readLogFromEeprom(i, logBuffer, LOG_SIZE);
             if (getChecksum(logBuffer, &tempLen) == 0)
@@ -649,6 +595,14 @@ void handleCommands()
     {
         zeroAllLogs();
     }
+
+    // If command is "stats"
+    else if (strncmp(uartread, "stats", 5) == 0)
+    {
+        const eepromCacheStats *stats = eeprom_cache_stats();
+        printf("EEPROM cache: %lu hits, %lu misses, %lu flushes, %lu bytes written\n",
+               (unsigned long)stats->hits, (unsigned long)stats->misses, (unsigned long)stats->flushes, (unsigned long)stats->bytesWritten);
+    }
 }
 
 void printLog(const uint8_t *logBuffer, const int logBufferLen, const int logEntryToRead)
@@ -661,20 +615,6 @@ void printLog(const uint8_t *logBuffer, const int logBufferLen, const int logEnt
     printf("\n");
 }
 
-void appendAddrToString(const uint8_t *string, int *stringLen, uint8_t *finalArray, const int address)
-{
-    uint16_t address16 = address;
-    uint8_t finalBuffer[2];
-
-    memcpy(finalArray + 2, string, *stringLen);
-    *stringLen += 2;
-
-    finalBuffer[0] = address16 >> 8;
-    finalBuffer[1] = address16 & 0xFF;
-    finalArray[0] = finalBuffer[0];
-    finalArray[1] = finalBuffer[1];
-}
-
 void enterLogToEeprom(const char *string, const int stringLen)
 {
     char logString[stringLen + 1];
@@ -683,33 +623,43 @@ void enterLogToEeprom(const char *string, const int stringLen)
 
     int logStringLen = strlen(logString);
     uint8_t base8LogString[LOG_SIZE];
-    uint8_t base8LogStringFinal[LOG_SIZE + 2]; // 2 bytes for the address
-
-    // Find the first empty log
-    int logIndex = 0;
-    int charsToRead = LOG_SIZE;
-    do
-    {
-        charsToRead = LOG_SIZE;
-        readLogFromEeprom(logIndex, base8LogString, LOG_SIZE);
-        logIndex++;
-    } while (getChecksum(base8LogString, &charsToRead) == 0 && logIndex <= MAX_LOGS);
-    logIndex--;
 
     // If all logs are full, erase them all
-    if (logIndex == MAX_LOGS)
+    if (logHead == MAX_LOGS)
     {
         zeroAllLogs();
-        logIndex = 0;
     }
 
     // Create base8 log string.
-    logStringLen = strlen(logString); // Reset logStringLen
     convertStringToBase8(logString, logStringLen, base8LogString);
     appendCrcToBase8String(base8LogString, &logStringLen);
-    appendAddrToString(base8LogString, &logStringLen, base8LogStringFinal, logIndex * LOG_SIZE);
 
-    // Write log to EEPROM
-    i2c_write_blocking(i2c_default, EEPROM_ADDR, base8LogStringFinal, logStringLen, false);
-    sleep_ms(EEPROM_WRITE_DELAY_MS);
+    // Write log to the first empty entry, it is always the one after the last write
+    eeprom_write(LOG_START_ADDR + logHead * LOG_SIZE, base8LogString, logStringLen);
+    logHead++;
+}
+
+// Finds the first empty log entry. Entries are written in order from the first one, so the
+// valid ones are all before it. Done once at boot, after that logHead follows the writes.
+void findLogHead()
+{
+    // The whole log area in one read instead of one transaction per entry. Static, it is as
+    // large as the default stack.
+    static uint8_t logArea[MAX_LOGS * LOG_SIZE];
+    int logLen = LOG_SIZE;
+
+    logHead = 0;
+    if (!eeprom_read(LOG_START_ADDR, logArea, sizeof(logArea)))
+    {
+        return;
+    }
+    while (logHead < MAX_LOGS)
+    {
+        logLen = LOG_SIZE;
+        if (getChecksum(logArea + logHead * LOG_SIZE, &logLen) != 0)
+        {
+            break;
+        }
+        logHead++;
+    }
 }
@@ -0,0 +1,207 @@
+//
+// Two cores writing to the same UART. Both cores queue numbered messages as fast as
+// the driver accepts them and the output on the simulated wire is checked:
+// every message must arrive whole and each core's messages must arrive in order.
+//
+// usage: uart_bench_multicore [baud] [messages] [tx_size] [rounds]
+//   baud      line speed (default 115200)
+//   messages  messages sent by each core per round (default 2000)
+//   tx_size   transmit buffer size of each core (default 256)
+//   rounds    number of runs, thread timing differs between runs (default 5)
+//
+// Core 1 also reads the statistics and sets the event callback while it sends, which must not
+// enable the UART interrupt on its NVIC, and writes from a core without a transmit buffer must
+// fail instead of waiting forever.
+//
+// Exits with status 1 if any message was lost, cut or out of order or either check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#include "sim_uart.h"
+#include "uart.h"
+
+#define UART_NR 1
+#define MSG_MAX 48
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} capture;
+
+static int messages;
+static capture wire;
+
+static uint64_t wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void capture_tx(int uart_nr, uint8_t c, void *ctx)
+{
+    (void) uart_nr;
+    capture *cap = ctx;
+    if(cap->size < cap->capacity) cap->data[cap->size] = c;
+    ++cap->size;
+}
+
+// Message n of a core, length varies so that messages wrap around the buffer end at different points
+static int make_message(char *msg, int core, int n)
+{
+    int len = snprintf(msg, MSG_MAX, "c%d %06d ", core, n);
+    int pad = n % 23;
+    for(int i = 0; i < pad; ++i) msg[len++] = (char) ('a' + (n + i) % 26);
+    msg[len++] = '\n';
+    return len;
+}
+
+static size_t expected_size(void)
+{
+    char msg[MSG_MAX];
+    size_t total = 0;
+    for(int n = 0; n < messages; ++n) total += 2 * make_message(msg, 0, n);
+    return total;
+}
+
+static void send_messages(void)
+{
+    char msg[MSG_MAX];
+    int core = (int) get_core_num();
+    if(core == 1) uart_set_event_callback(UART_NR, NULL);
+    for(int n = 0; n < messages; ++n) {
+        if(core == 1 && n % 100 == 0) {
+            uart_stats stats;
+            uart_get_stats(UART_NR, &stats);
+        }
+        int len = make_message(msg, core, n);
+        // message is queued whole or not at all, wait for the ISR to free space
+        while(!uart_write_atomic(UART_NR, (const uint8_t *) msg, len)) __wfe();
+    }
+}
+
+// Returns number of errors, switches counts how often the wire changed from one core to the other
+static int check(const capture *cap, int *switches)
+{
+    int next[2] = { 0, 0 };
+    int errors = 0;
+    int last = -1;
+    char msg[MSG_MAX];
+    size_t pos = 0;
+    *switches = 0;
+    while(pos < cap->size) {
+        const uint8_t *line = cap->data + pos;
+        const uint8_t *end = memchr(line, '\n', cap->size - pos);
+        size_t len = end ? (size_t) (end - line) + 1 : cap->size - pos;
+        int core = len > 1 && line[0] == 'c' ? line[1] - '0' : -1;
+        if(core != 0 && core != 1) {
+            if(errors++ < 5) printf("  garbage at %zu\n", pos);
+        }
+        else {
+            int n = next[core]++;
+            int expected = make_message(msg, core, n);
+            if((size_t) expected != len || memcmp(msg, line, len) != 0) {
+                if(errors++ < 5) printf("  core %d message %d wrong at %zu: %.*s", core, n, pos, (int) len, line);
+            }
+            if(last >= 0 && core != last) ++*switches;
+            last = core;
+        }
+        pos += len;
+    }
+    if(next[0] != messages || next[1] != messages) {
+        printf("  received %d + %d messages, expected %d each\n", next[0], next[1], messages);
+        ++errors;
+    }
+    return errors;
+}
+
+static int core1_send_result;
+
+static void send_without_buffer(void)
+{
+    core1_send_result = uart_send(UART_NR, "no buffer\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t baud = argc > 1 ? (uint32_t) atoi(argv[1]) : 115200;
+    messages = argc > 2 ? atoi(argv[2]) : 2000;
+    int tx_size = argc > 3 ? atoi(argv[3]) : 256;
+    int rounds = argc > 4 ? atoi(argv[4]) : 5;
+
+    uint8_t *rx_buffer = malloc(256);
+    uint8_t *tx_buffer[2] = { malloc(tx_size), malloc(tx_size) };
+    size_t total = expected_size();
+    wire.capacity = total;
+    wire.data = malloc(total);
+
+    printf("baud %u, %d messages per core, %d byte buffers\n", baud, messages, tx_size);
+    printf("round     bytes        B/s  line%%  ISR/KiB switches   host ms errors\n");
+
+    int failed = 0;
+    for(int round = 0; round < rounds; ++round) {
+        sim_reset();
+        uart_setup_buffers(UART_NR, 4, 5, (int) baud, rx_buffer, 256, tx_buffer[0], tx_size);
+        uart_set_core1_tx_buffer(UART_NR, tx_buffer[1], tx_size);
+        wire.size = 0;
+        sim_uart_set_tx_sink(UART_NR, capture_tx, &wire);
+
+        uint64_t host_start = wall_ns();
+        multicore_launch_core1(send_messages);
+        send_messages();
+        // core 1 and the transmitter need the clock to keep moving
+        while(!sim_core1_done() || wire.size < total || !sim_uart_tx_idle(UART_NR)) {
+            sleep_us(100);
+            if(sim_core1_done() && sim_uart_tx_idle(UART_NR) && wire.size < total) {
+                // nothing left to send, data has been lost
+                sleep_us(10000);
+                if(sim_uart_tx_idle(UART_NR)) break;
+            }
+        }
+        sim_core1_join();
+        uint64_t host_ns = wall_ns() - host_start;
+
+        sim_uart_counters hw;
+        sim_uart_get_counters(UART_NR, &hw);
+        int switches;
+        int errors = check(&wire, &switches);
+        if(hw.core1_irqs) {
+            printf("  UART interrupt enabled on core 1 for %u interrupts\n", hw.core1_irqs);
+            ++errors;
+        }
+        double seconds = sim_now_ns() / 1e9;
+        double rate = seconds > 0 ? wire.size / seconds : 0.0;
+        printf("%5d %9zu %10.0f %6.1f %8.1f %8d %9.1f %6d\n",
+               round, wire.size, rate, 100.0 * rate * 10 / baud, hw.irq_count / (wire.size / 1024.0),
+               switches, host_ns / 1e6, errors);
+        if(errors) failed = 1;
+    }
+
+    // core 1 without a transmit buffer
+    sim_reset();
+    uart_setup_buffers(UART_NR, 4, 5, (int) baud, rx_buffer, 256, tx_buffer[0], tx_size);
+    multicore_launch_core1(send_without_buffer);
+    for(int i = 0; i < 1000 && !sim_core1_done(); ++i) sleep_us(100);
+    if(!sim_core1_done()) {
+        // core 1 is stuck waiting for space that never comes, it can't be joined
+        printf("uart_send on core 1 without a buffer did not return\n");
+        return 1;
+    }
+    sim_core1_join();
+    if(core1_send_result != -1) {
+        printf("uart_send on core 1 without a buffer returned %d, expected -1\n", core1_send_result);
+        failed = 1;
+    }
+
+    free(rx_buffer);
+    free(tx_buffer[0]);
+    free(tx_buffer[1]);
+    free(wire.data);
+    return failed;
+}
@@ -0,0 +1,236 @@
+//
+// Throughput benchmark for the uart_irq driver running against the simulated PL011.
+//
+// usage: uart_bench [baud] [bytes] [poll_us] [rx_size] [tx_size]
+//   baud     line speed (default 115200)
+//   bytes    amount of data to receive and to transmit (default 65536)
+//   poll_us  how often the application reads/writes the driver (default 1000)
+//   rx_size  receive buffer size, tx_size transmit buffer size
+//            (default: run all sizes from 64 to 1024 with equal buffers)
+//
+// Before the benchmark, idle detection is checked with messages of 1 to 40 characters, which
+// includes lengths where the ISR empties the fifo at the watermark and the receive timeout
+// interrupt never fires. Each message must be reported idle exactly once, 32 bit periods after
+// its last character. uart_read_line() is checked with lines longer than the caller's buffer,
+// which must come out in pieces whether their end has arrived or not. Exits with status 1 if
+// either check fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "sim_uart.h"
+#include "uart.h"
+
+#define UART_NR 1
+#define CHUNK 64
+
+static uint64_t wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void count_tx(int uart_nr, uint8_t c, void *ctx)
+{
+    (void) uart_nr;
+    (void) c;
+    ++*(size_t *) ctx;
+}
+
+static void print_result(const char *name, int rx_size, int tx_size, size_t bytes, size_t delivered,
+                         uint64_t sim_ns, uint64_t host_ns, const sim_uart_counters *hw, const uart_stats *st)
+{
+    double seconds = sim_ns / 1e9;
+    double kib = bytes / 1024.0;
+    uint32_t lost = st->rx_dropped + hw->fifo_overruns;
+    printf("%-3s %6d %6d %9zu %10.0f %9.1f %8.3f%% %6u %6u %9.0f\n",
+           name, rx_size, tx_size, delivered, seconds > 0 ? delivered / seconds : 0.0,
+           hw->irq_count / kib, 100.0 * lost / bytes,
+           st->rx_high_water, st->tx_high_water,
+           hw->irq_count ? (double) host_ns / hw->irq_count : 0.0);
+}
+
+// Returns the number of message lengths whose idle line was not reported correctly
+static int check_idle(uint32_t baud, const uint8_t *data)
+{
+    uint8_t rx_buffer[256], tx_buffer[64], buffer[CHUNK];
+    uint64_t char_ns = 10 * 1000000000ull / baud;
+    uint64_t idle_ns = 32 * 1000000000ull / baud;
+    int errors = 0;
+    for(size_t len = 1; len <= 40; ++len) {
+        sim_reset();
+        uart_setup_buffers(UART_NR, 4, 5, (int) baud, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer));
+        sim_uart_start_rx(UART_NR, data, len);
+        uint64_t end_ns = sim_now_ns() + len * char_ns;
+        size_t delivered = 0;
+        uint32_t timeout_us = (uint32_t) ((len * char_ns + idle_ns) / 1000) + 10000;
+        uint32_t events = uart_wait_events(UART_NR, UART_EVENT_RX_IDLE, timeout_us);
+        uint64_t idle_at = sim_now_ns();
+        int n;
+        while((n = uart_read(UART_NR, buffer, CHUNK)) > 0) delivered += n;
+        // a second idle event without new data is wrong too
+        uint32_t again = uart_wait_events(UART_NR, UART_EVENT_RX_IDLE, timeout_us);
+        // receive timeout fires 32 bit periods after the last character, the alarm up to 4 characters later
+        bool late = idle_at > end_ns + idle_ns + 4 * char_ns;
+        // times are rounded to whole microseconds
+        bool early = idle_at + 2000 < end_ns + idle_ns;
+        if(!events || again || delivered != len || early || late) {
+            printf("idle: %zu characters: %s, %zu delivered, reported %.0f us after the end%s\n",
+                   len, events ? "idle" : "no idle", delivered, ((double) idle_at - end_ns) / 1000,
+                   again ? ", reported twice" : "");
+            ++errors;
+        }
+    }
+    return errors;
+}
+
+static void run(uint32_t baud, const uint8_t *data, size_t bytes, uint32_t poll_us, int rx_size, int tx_size)
+{
+    uint8_t *rx_buffer = malloc(rx_size);
+    uint8_t *tx_buffer = malloc(tx_size);
+    sim_uart_counters hw;
+    uart_stats st;
+
+    // receive: remote sends continuously, application polls the driver periodically
+    sim_reset();
+    uart_setup_buffers(UART_NR, 4, 5, (int) baud, rx_buffer, rx_size, tx_buffer, tx_size);
+    size_t delivered = 0;
+    uint8_t buffer[CHUNK];
+    uint64_t start = sim_now_ns();
+    uint64_t host_start = wall_ns();
+    sim_uart_start_rx(UART_NR, data, bytes);
+    while(!sim_uart_rx_done(UART_NR)) {
+        sleep_us(poll_us);
+        int n;
+        while((n = uart_read(UART_NR, buffer, CHUNK)) > 0) delivered += n;
+    }
+    // let the receive timeout flush the fifo tail
+    sleep_us(poll_us + 1000);
+    int n;
+    while((n = uart_read(UART_NR, buffer, CHUNK)) > 0) delivered += n;
+    uint64_t host_ns = wall_ns() - host_start;
+    sim_uart_get_counters(UART_NR, &hw);
+    uart_get_stats(UART_NR, &st);
+    print_result("rx", rx_size, tx_size, bytes, delivered, sim_now_ns() - start, host_ns, &hw, &st);
+
+    // event driven receive: application sleeps until driver reports data or idle line
+    sim_reset();
+    uart_setup_buffers(UART_NR, 4, 5, (int) baud, rx_buffer, rx_size, tx_buffer, tx_size);
+    delivered = 0;
+    start = sim_now_ns();
+    host_start = wall_ns();
+    sim_uart_start_rx(UART_NR, data, bytes);
+    while(delivered < bytes) {
+        if(!uart_wait_events(UART_NR, UART_EVENT_RX_DATA | UART_EVENT_RX_IDLE, poll_us)) {
+            if(sim_uart_rx_done(UART_NR)) break;
+        }
+        while((n = uart_read(UART_NR, buffer, CHUNK)) > 0) delivered += n;
+    }
+    host_ns = wall_ns() - host_start;
+    sim_uart_get_counters(UART_NR, &hw);
+    uart_get_stats(UART_NR, &st);
+    print_result("rxw", rx_size, tx_size, bytes, delivered, sim_now_ns() - start, host_ns, &hw, &st);
+
+    // transmit: application pushes data as fast as the driver accepts it
+    sim_reset();
+    uart_setup_buffers(UART_NR, 4, 5, (int) baud, rx_buffer, rx_size, tx_buffer, tx_size);
+    size_t sent = 0;
+    sim_uart_set_tx_sink(UART_NR, count_tx, &sent);
+    size_t queued = 0;
+    start = sim_now_ns();
+    host_start = wall_ns();
+    while(sent < bytes) {
+        if(queued < bytes) {
+            size_t size = bytes - queued < CHUNK ? bytes - queued : CHUNK;
+            int count = uart_write(UART_NR, data + queued, (int) size);
+            queued += count;
+            if(count == (int) size) continue;
+        }
+        sleep_us(poll_us);
+    }
+    host_ns = wall_ns() - host_start;
+    sim_uart_get_counters(UART_NR, &hw);
+    uart_get_stats(UART_NR, &st);
+    print_result("tx", rx_size, tx_size, bytes, sent, sim_now_ns() - start, host_ns, &hw, &st);
+
+    // blocking transmit: writer sleeps until transmit interrupt frees space
+    sim_reset();
+    uart_setup_buffers(UART_NR, 4, 5, (int) baud, rx_buffer, rx_size, tx_buffer, tx_size);
+    sent = 0;
+    sim_uart_set_tx_sink(UART_NR, count_tx, &sent);
+    start = sim_now_ns();
+    host_start = wall_ns();
+    for(queued = 0; queued < bytes; queued += CHUNK) {
+        size_t size = bytes - queued < CHUNK ? bytes - queued : CHUNK;
+        uart_write_all(UART_NR, data + queued, (int) size);
+    }
+    while(sent < bytes) sleep_us(poll_us);
+    host_ns = wall_ns() - host_start;
+    sim_uart_get_counters(UART_NR, &hw);
+    uart_get_stats(UART_NR, &st);
+    print_result("txb", rx_size, tx_size, bytes, sent, sim_now_ns() - start, host_ns, &hw, &st);
+
+    free(rx_buffer);
+    free(tx_buffer);
+}
+
+static int check_read_line(uint32_t baud)
+{
+    static const char input[] = "hello\r\nabcdefghij\r\nabcdefg\r\nxy\n";
+    static const char *const expected[] = { "hello", "abcdefg", "hij", "abcdefg", "xy" };
+    uint8_t rx_buffer[256], tx_buffer[64];
+    char str[8];
+    int errors = 0;
+    sim_reset();
+    uart_setup_buffers(UART_NR, 4, 5, (int) baud, rx_buffer, sizeof(rx_buffer), tx_buffer, sizeof(tx_buffer));
+    if(uart_read_line(UART_NR, str, 0, 0) != -1 || uart_read_line(UART_NR, str, 1, 0) != -1) {
+        printf("read_line: buffer too small for a character was accepted\n");
+        ++errors;
+    }
+    sim_uart_start_rx(UART_NR, (const uint8_t *) input, sizeof(input) - 1);
+    for(size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        int n = uart_read_line(UART_NR, str, sizeof(str), 100000);
+        if(n != (int) strlen(expected[i]) || strcmp(str, expected[i]) != 0) {
+            printf("read_line: got %d \"%s\", expected \"%s\"\n", n, n < 0 ? "" : str, expected[i]);
+            ++errors;
+        }
+    }
+    if(uart_read_line(UART_NR, str, sizeof(str), 10000) != -1) {
+        printf("read_line: got \"%s\" after the last line\n", str);
+        ++errors;
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t baud = argc > 1 ? (uint32_t) atoi(argv[1]) : 115200;
+    size_t bytes = argc > 2 ? (size_t) atol(argv[2]) : 65536;
+    uint32_t poll_us = argc > 3 ? (uint32_t) atoi(argv[3]) : 1000;
+
+    uint8_t *data = malloc(bytes);
+    for(size_t i = 0; i < bytes; ++i) data[i] = (uint8_t) i;
+
+    int idle_errors = check_idle(baud, data);
+    printf("idle detection: %s\n", idle_errors ? "FAILED" : "ok");
+    int line_errors = check_read_line(baud);
+    printf("read line: %s\n", line_errors ? "FAILED" : "ok");
+
+    printf("baud %u, %zu bytes, poll every %u us\n", baud, bytes, poll_us);
+    printf("dir     rx     tx delivered        B/s   ISR/KiB      drop rx_hwm tx_hwm    ns/ISR\n");
+
+    if(argc > 5) {
+        run(baud, data, bytes, poll_us, atoi(argv[4]), atoi(argv[5]));
+    }
+    else {
+        for(int size = 64; size <= 1024; size *= 2) {
+            run(baud, data, bytes, poll_us, size, size);
+        }
+    }
+
+    free(data);
+    return idle_errors || line_errors ? 1 : 0;
+}
@@ -0,0 +1,18 @@
+//
+// Host replacement for hardware/irq.h. Only the UART interrupts are simulated.
+//
+
+#ifndef UART_IRQ_HOST_HARDWARE_IRQ_H
+#define UART_IRQ_HOST_HARDWARE_IRQ_H
+
+#include <stdbool.h>
+
+#define UART0_IRQ 20
+#define UART1_IRQ 21
+
+typedef void (*irq_handler_t)(void);
+
+void irq_set_enabled(unsigned int num, bool enabled);
+void irq_set_exclusive_handler(unsigned int num, irq_handler_t handler);
+
+#endif //UART_IRQ_HOST_HARDWARE_IRQ_H
@@ -0,0 +1,24 @@
+//
+// Host replacement for hardware/sync.h. The event register is simulated:
+// __wfe() advances simulated time until somebody executes __sev().
+// Spin locks are plain atomic flags. Interrupts do not need to be masked while one
+// is held because the simulated handler only runs between driver calls on core 0.
+//
+
+#ifndef UART_IRQ_HOST_HARDWARE_SYNC_H
+#define UART_IRQ_HOST_HARDWARE_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef volatile uint32_t spin_lock_t;
+
+void __sev(void);
+void __wfe(void);
+
+int spin_lock_claim_unused(bool required);
+spin_lock_t *spin_lock_instance(unsigned int lock_num);
+uint32_t spin_lock_blocking(spin_lock_t *lock);
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq);
+
+#endif //UART_IRQ_HOST_HARDWARE_SYNC_H
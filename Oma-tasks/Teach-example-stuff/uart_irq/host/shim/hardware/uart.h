@@ -0,0 +1,47 @@
+//
+// Host replacement for hardware/uart.h backed by a simulated PL011.
+// Register layout is reduced to the registers the driver touches.
+//
+
+#ifndef UART_IRQ_HOST_HARDWARE_UART_H
+#define UART_IRQ_HOST_HARDWARE_UART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define UART_UARTIMSC_RXIM_LSB 4
+#define UART_UARTIMSC_TXIM_LSB 5
+#define UART_UARTIMSC_RTIM_LSB 6
+
+#define UART_UARTRSR_FE_BITS 0x00000001
+#define UART_UARTRSR_PE_BITS 0x00000002
+#define UART_UARTRSR_BE_BITS 0x00000004
+#define UART_UARTRSR_OE_BITS 0x00000008
+
+#define UART_UARTMIS_RXMIS_BITS 0x00000010
+#define UART_UARTMIS_TXMIS_BITS 0x00000020
+#define UART_UARTMIS_RTMIS_BITS 0x00000040
+
+typedef struct {
+    volatile uint32_t dr;
+    volatile uint32_t rsr;
+    volatile uint32_t imsc;
+    volatile uint32_t mis;
+} uart_hw_t;
+
+typedef struct uart_inst {
+    int nr;
+} uart_inst_t;
+
+extern uart_inst_t sim_uart_inst[2];
+#define uart0 (&sim_uart_inst[0])
+#define uart1 (&sim_uart_inst[1])
+
+uart_hw_t *uart_get_hw(uart_inst_t *uart);
+unsigned int uart_init(uart_inst_t *uart, unsigned int baudrate);
+bool uart_is_readable(uart_inst_t *uart);
+bool uart_is_writable(uart_inst_t *uart);
+char uart_getc(uart_inst_t *uart);
+void uart_set_irq_enables(uart_inst_t *uart, bool rx_has_data, bool tx_needs_data);
+
+#endif //UART_IRQ_HOST_HARDWARE_UART_H
@@ -0,0 +1,10 @@
+//
+// Host replacement for pico/multicore.h. Core 1 is a thread, see sim_multicore.c.
+//
+
+#ifndef UART_IRQ_HOST_PICO_MULTICORE_H
+#define UART_IRQ_HOST_PICO_MULTICORE_H
+
+void multicore_launch_core1(void (*entry)(void));
+
+#endif //UART_IRQ_HOST_PICO_MULTICORE_H
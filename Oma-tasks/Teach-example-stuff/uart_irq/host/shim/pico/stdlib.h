@@ -0,0 +1,28 @@
+//
+// Host replacement for the parts of pico/stdlib.h that the uart_irq driver uses.
+// Time is simulated: sleeping and busy waiting advance the simulated clock
+// which in turn moves data through the simulated UARTs (see sim_uart.h).
+//
+
+#ifndef UART_IRQ_HOST_PICO_STDLIB_H
+#define UART_IRQ_HOST_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+
+#include "pico/time.h"
+#include "hardware/irq.h"
+#include "hardware/uart.h"
+
+#define GPIO_FUNC_UART 2
+
+static inline void gpio_set_function(uint gpio, int fn) { (void) gpio; (void) fn; }
+
+void tight_loop_contents(void);
+// 0 on the main thread, 1 on the thread started by multicore_launch_core1()
+uint get_core_num(void);
+
+#endif //UART_IRQ_HOST_PICO_STDLIB_H
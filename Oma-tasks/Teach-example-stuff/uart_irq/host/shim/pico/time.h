@@ -0,0 +1,36 @@
+//
+// Host replacement for pico/time.h on top of the simulated clock.
+//
+
+#ifndef UART_IRQ_HOST_PICO_TIME_H
+#define UART_IRQ_HOST_PICO_TIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint64_t absolute_time_t;
+
+#define nil_time ((absolute_time_t) 0)
+#define at_the_end_of_time ((absolute_time_t) UINT64_MAX)
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+static inline absolute_time_t get_absolute_time(void) { return time_us_64(); }
+static inline absolute_time_t make_timeout_time_us(uint64_t us) { return time_us_64() + us; }
+static inline bool time_reached(absolute_time_t t) { return time_us_64() >= t; }
+
+// Sleeps until an event (__sev) or until timeout, returns true if timeout was reached
+bool best_effort_wfe_or_timeout(absolute_time_t timeout);
+
+// Alarms run on core 0 like the simulated interrupt handlers. The return value of the callback works
+// as in the SDK: 0 ends the alarm, > 0 reschedules it that many us from now, < 0 from the previous target.
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t alarm_id);
+
+#endif //UART_IRQ_HOST_PICO_TIME_H
@@ -0,0 +1,78 @@
+//
+// Simulated second core and spin locks for host builds of the uart_irq driver.
+//
+#include <sched.h>
+#include <pthread.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#include "sim_uart.h"
+
+#define SIM_SPIN_LOCK_COUNT 32
+
+static _Thread_local uint core_num;
+static spin_lock_t spin_locks[SIM_SPIN_LOCK_COUNT];
+static int next_spin_lock;
+
+static pthread_t core1_thread;
+static bool core1_running;
+static _Atomic bool core1_done;
+
+uint get_core_num(void)
+{
+    return core_num;
+}
+
+static void *core1_main(void *arg)
+{
+    core_num = 1;
+    ((void (*)(void)) arg)();
+    core1_done = true;
+    return NULL;
+}
+
+void multicore_launch_core1(void (*entry)(void))
+{
+    core1_done = false;
+    core1_running = pthread_create(&core1_thread, NULL, core1_main, (void *) entry) == 0;
+}
+
+bool sim_core1_done(void)
+{
+    return core1_done;
+}
+
+bool sim_core1_active(void)
+{
+    return core1_running && !core1_done;
+}
+
+void sim_core1_join(void)
+{
+    if(!core1_running) return;
+    pthread_join(core1_thread, NULL);
+    core1_running = false;
+}
+
+int spin_lock_claim_unused(bool required)
+{
+    (void) required;
+    return next_spin_lock < SIM_SPIN_LOCK_COUNT ? next_spin_lock++ : -1;
+}
+
+spin_lock_t *spin_lock_instance(unsigned int lock_num)
+{
+    return &spin_locks[lock_num];
+}
+
+uint32_t spin_lock_blocking(spin_lock_t *lock)
+{
+    while(__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) sched_yield();
+    return 0;
+}
+
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq)
+{
+    (void) saved_irq;
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
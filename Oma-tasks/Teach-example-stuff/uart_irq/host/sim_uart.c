@@ -0,0 +1,523 @@
+//
+// Simulated PL011 UART and simulated time for host builds of the uart_irq driver.
+//
+// Core 0 (the main thread) drives the simulation and takes the interrupts. Core 1
+// (see sim_multicore.c) runs on its own thread and only waits for time to move.
+// Simulator state is protected by sim_mutex which is never held while a handler runs,
+// so the driver's own synchronization is what keeps the cores apart.
+//
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "sim_uart.h"
+
+// driver writes characters to dr, the value is picked up by the simulator
+// before the next register access or when the handler returns
+#define SIM_DR_IDLE 0xFFFFFFFFu
+#define SIM_RX_IRQ_LEVEL 4
+#define SIM_TX_IRQ_LEVEL 4
+#define SIM_NO_EVENT UINT64_MAX
+#define SIM_ALARMS 8
+
+typedef struct {
+    uart_hw_t hw;
+    uint64_t char_ns;
+    irq_handler_t handler;
+    bool nvic_enabled[2]; // each core has its own NVIC
+    bool in_handler;
+
+    uint8_t rx_fifo[SIM_UART_FIFO_DEPTH];
+    unsigned rx_rd;
+    unsigned rx_count;
+    bool rx_timeout;        // receive timeout interrupt status
+    uint64_t rx_timeout_ns; // when receive timeout fires, SIM_NO_EVENT if not armed
+
+    uint8_t tx_fifo[SIM_UART_FIFO_DEPTH];
+    unsigned tx_rd;
+    unsigned tx_count;
+    uint64_t tx_done_ns;    // when the first character of tx fifo has been shifted out
+
+    const uint8_t *wire;
+    size_t wire_size;
+    size_t wire_pos;
+    uint64_t wire_next_ns;
+
+    sim_tx_sink_t tx_sink;
+    void *tx_ctx;
+    sim_uart_counters counters;
+} sim_uart;
+
+uart_inst_t sim_uart_inst[2] = { { .nr = 0 }, { .nr = 1 } };
+
+typedef struct {
+    alarm_id_t id;          // 0 if the slot is free
+    uint64_t at_ns;
+    alarm_callback_t callback;
+    void *user_data;
+} sim_alarm;
+
+static sim_uart sims[2];
+static sim_alarm alarms[SIM_ALARMS];
+static alarm_id_t last_alarm_id;
+static pthread_mutex_t sim_mutex = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic uint64_t now_ns;
+static _Atomic bool event_flag[2]; // event registers of the cores for __sev/__wfe
+// what core 1 is waiting for, see sim_core1_idle()
+static _Atomic bool core1_waiting;
+static _Atomic bool core1_wake_on_event;
+static _Atomic uint64_t core1_wake_ns;
+
+static void sim_lock(void)
+{
+    pthread_mutex_lock(&sim_mutex);
+}
+
+static void sim_unlock(void)
+{
+    pthread_mutex_unlock(&sim_mutex);
+}
+
+static sim_uart *sim_get(int uart_nr)
+{
+    return &sims[uart_nr ? 1 : 0];
+}
+
+static sim_uart *sim_from_inst(uart_inst_t *uart)
+{
+    return sim_get(uart->nr);
+}
+
+static sim_uart *sim_from_irq(unsigned int num)
+{
+    return num == UART1_IRQ ? &sims[1] : &sims[0];
+}
+
+// Moves a character written by the driver to the tx fifo. The driver writes dr without
+// sim_mutex so the character is taken with an atomic exchange.
+static void sim_collect_tx(sim_uart *s)
+{
+    uint32_t dr = __atomic_exchange_n(&s->hw.dr, SIM_DR_IDLE, __ATOMIC_ACQ_REL);
+    if(dr == SIM_DR_IDLE) return;
+    if(s->tx_count < SIM_UART_FIFO_DEPTH) {
+        if(s->tx_count == 0) s->tx_done_ns = now_ns + s->char_ns;
+        s->tx_fifo[(s->tx_rd + s->tx_count) % SIM_UART_FIFO_DEPTH] = (uint8_t) dr;
+        ++s->tx_count;
+    }
+}
+
+// Masked interrupt status
+static uint32_t sim_mis(sim_uart *s)
+{
+    uint32_t ris = 0;
+    if(s->rx_count >= SIM_RX_IRQ_LEVEL) ris |= UART_UARTMIS_RXMIS_BITS;
+    if(s->tx_count <= SIM_TX_IRQ_LEVEL) ris |= UART_UARTMIS_TXMIS_BITS;
+    if(s->rx_timeout) ris |= UART_UARTMIS_RTMIS_BITS;
+    return ris & s->hw.imsc;
+}
+
+static bool sim_irq_pending(sim_uart *s)
+{
+    return sim_mis(s) != 0;
+}
+
+// Runs the handler if the interrupt is pending. Handlers run on core 0 only, an interrupt that core 1
+// has enabled too is counted in core1_irqs because on the hardware both cores would take it.
+// Called without sim_mutex.
+static void sim_check_irq(sim_uart *s)
+{
+    if(get_core_num() != 0) return;
+    sim_lock();
+    sim_collect_tx(s);
+    bool take = s->nvic_enabled[0] && !s->in_handler && s->handler != NULL && sim_irq_pending(s);
+    if(take) {
+        s->in_handler = true;
+        ++s->counters.irq_count;
+        if(s->nvic_enabled[1]) ++s->counters.core1_irqs;
+    }
+    sim_unlock();
+    if(!take) return;
+    s->handler();
+    sim_lock();
+    sim_collect_tx(s);
+    s->in_handler = false;
+    sim_unlock();
+}
+
+static uint64_t sim_next_event(sim_uart *s)
+{
+    uint64_t t = SIM_NO_EVENT;
+    if(s->wire_pos < s->wire_size && s->wire_next_ns < t) t = s->wire_next_ns;
+    if(s->tx_count > 0 && s->tx_done_ns < t) t = s->tx_done_ns;
+    if(s->rx_timeout_ns < t) t = s->rx_timeout_ns;
+    return t;
+}
+
+static void sim_process(sim_uart *s, int uart_nr)
+{
+    if(s->wire_pos < s->wire_size && s->wire_next_ns <= now_ns) {
+        ++s->counters.rx_bytes;
+        if(s->rx_count < SIM_UART_FIFO_DEPTH) {
+            s->rx_fifo[(s->rx_rd + s->rx_count) % SIM_UART_FIFO_DEPTH] = s->wire[s->wire_pos];
+            ++s->rx_count;
+        }
+        else {
+            ++s->counters.fifo_overruns;
+            s->hw.rsr |= UART_UARTRSR_OE_BITS;
+        }
+        ++s->wire_pos;
+        s->wire_next_ns += s->char_ns;
+        s->rx_timeout_ns = now_ns + s->char_ns * 32 / 10;
+    }
+    if(s->tx_count > 0 && s->tx_done_ns <= now_ns) {
+        uint8_t c = s->tx_fifo[s->tx_rd];
+        s->tx_rd = (s->tx_rd + 1) % SIM_UART_FIFO_DEPTH;
+        --s->tx_count;
+        ++s->counters.tx_bytes;
+        if(s->tx_count > 0) s->tx_done_ns += s->char_ns;
+        if(s->tx_sink) s->tx_sink(uart_nr, c, s->tx_ctx);
+    }
+    if(s->rx_timeout_ns <= now_ns) {
+        s->rx_timeout_ns = SIM_NO_EVENT;
+        if(s->rx_count > 0) s->rx_timeout = true;
+    }
+}
+
+void sim_reset(void)
+{
+    now_ns = 0;
+    event_flag[0] = event_flag[1] = false;
+    core1_waiting = false;
+    memset(alarms, 0, sizeof(alarms));
+    for(int i = 0; i < 2; ++i) {
+        memset(&sims[i], 0, sizeof(sims[i]));
+        sims[i].hw.dr = SIM_DR_IDLE;
+        sims[i].rx_timeout_ns = SIM_NO_EVENT;
+        sims[i].char_ns = 10 * 1000000000ull / 115200;
+    }
+}
+
+uint64_t sim_now_ns(void)
+{
+    return now_ns;
+}
+
+// Runs the simulation until target time. If stop_on_event is set returns early
+// when a handler executes __sev(). Returns true if stopped because of an event.
+// Core 1 is idle when it has finished or waits for something that has not happened yet
+static bool sim_core1_idle(void)
+{
+    if(!sim_core1_active()) return true;
+    if(!core1_waiting) return false;
+    if(core1_wake_on_event && event_flag[1]) return false;
+    return now_ns < core1_wake_ns;
+}
+
+// Clock must not move while core 1 is running
+static void sim_core1_sync(void)
+{
+    while(!sim_core1_idle()) sched_yield();
+}
+
+// Core 1 waits until core 0 has moved the clock to target or an event is signalled.
+// Returns true if woken by an event.
+static bool sim_core1_wait(uint64_t target, bool on_event)
+{
+    core1_wake_ns = target;
+    core1_wake_on_event = on_event;
+    core1_waiting = true;
+    while(!(on_event && event_flag[1]) && now_ns < target) sched_yield();
+    core1_waiting = false;
+    bool event = on_event && event_flag[1];
+    if(event) event_flag[1] = false;
+    return event;
+}
+
+// Called with sim_mutex
+static uint64_t sim_next_alarm(void)
+{
+    uint64_t t = SIM_NO_EVENT;
+    for(int i = 0; i < SIM_ALARMS; ++i) {
+        if(alarms[i].id && alarms[i].at_ns < t) t = alarms[i].at_ns;
+    }
+    return t;
+}
+
+// Runs the callbacks of alarms that are due. Called without sim_mutex.
+static void sim_run_alarms(void)
+{
+    for(;;) {
+        sim_lock();
+        sim_alarm due = { 0 };
+        for(int i = 0; i < SIM_ALARMS && !due.id; ++i) {
+            if(alarms[i].id && alarms[i].at_ns <= now_ns) due = alarms[i];
+        }
+        sim_unlock();
+        if(!due.id) return;
+        int64_t again = due.callback(due.id, due.user_data);
+        sim_lock();
+        for(int i = 0; i < SIM_ALARMS; ++i) {
+            // the callback may have cancelled its own alarm
+            if(alarms[i].id != due.id) continue;
+            if(again == 0) alarms[i].id = 0;
+            else if(again > 0) alarms[i].at_ns = now_ns + (uint64_t) again * 1000;
+            else alarms[i].at_ns = due.at_ns + (uint64_t) -again * 1000;
+        }
+        sim_unlock();
+    }
+}
+
+// Only core 0 calls this.
+static bool sim_run(uint64_t target, bool stop_on_event)
+{
+    for(;;) {
+        if(stop_on_event && event_flag[0]) return true;
+        sim_core1_sync();
+        sim_lock();
+        sim_collect_tx(&sims[0]);
+        sim_collect_tx(&sims[1]);
+        uint64_t t0 = sim_next_event(&sims[0]);
+        uint64_t t1 = sim_next_event(&sims[1]);
+        uint64_t t = t0 < t1 ? t0 : t1;
+        uint64_t ta = sim_next_alarm();
+        if(ta < t) t = ta;
+        // sleeping core 1 wakes up at the right time
+        if(sim_core1_active() && core1_waiting && core1_wake_ns < t) t = core1_wake_ns;
+        if(t > target || t == SIM_NO_EVENT) {
+            sim_unlock();
+            break;
+        }
+        if(t > now_ns) now_ns = t;
+        sim_process(&sims[0], 0);
+        sim_process(&sims[1], 1);
+        sim_unlock();
+        sim_check_irq(&sims[0]);
+        sim_check_irq(&sims[1]);
+        sim_run_alarms();
+    }
+    // waiting forever with nothing going on returns without moving the clock
+    sim_core1_sync();
+    if(target != UINT64_MAX) now_ns = target;
+    sim_check_irq(&sims[0]);
+    sim_check_irq(&sims[1]);
+    return stop_on_event && event_flag[0];
+}
+
+void sim_advance_ns(uint64_t ns)
+{
+    if(get_core_num() != 0) sim_core1_wait(now_ns + ns, false);
+    else sim_run(now_ns + ns, false);
+}
+
+void sim_uart_start_rx(int uart_nr, const uint8_t *data, size_t size)
+{
+    sim_uart *s = sim_get(uart_nr);
+    s->wire = data;
+    s->wire_size = size;
+    s->wire_pos = 0;
+    s->wire_next_ns = now_ns + s->char_ns;
+}
+
+bool sim_uart_rx_done(int uart_nr)
+{
+    sim_uart *s = sim_get(uart_nr);
+    return s->wire_pos == s->wire_size;
+}
+
+bool sim_uart_tx_idle(int uart_nr)
+{
+    sim_uart *s = sim_get(uart_nr);
+    sim_lock();
+    sim_collect_tx(s);
+    bool idle = s->tx_count == 0;
+    sim_unlock();
+    return idle;
+}
+
+void sim_uart_set_tx_sink(int uart_nr, sim_tx_sink_t sink, void *ctx)
+{
+    sim_uart *s = sim_get(uart_nr);
+    sim_lock();
+    s->tx_sink = sink;
+    s->tx_ctx = ctx;
+    sim_unlock();
+}
+
+void sim_uart_get_counters(int uart_nr, sim_uart_counters *counters)
+{
+    sim_lock();
+    *counters = sim_get(uart_nr)->counters;
+    sim_unlock();
+}
+
+// SDK functions used by the driver
+
+uart_hw_t *uart_get_hw(uart_inst_t *uart)
+{
+    sim_uart *s = sim_from_inst(uart);
+    sim_lock();
+    sim_collect_tx(s);
+    s->hw.mis = sim_mis(s);
+    sim_unlock();
+    return &s->hw;
+}
+
+unsigned int uart_init(uart_inst_t *uart, unsigned int baudrate)
+{
+    sim_uart *s = sim_from_inst(uart);
+    sim_lock();
+    s->char_ns = 10 * 1000000000ull / baudrate;
+    s->rx_count = 0;
+    s->tx_count = 0;
+    s->rx_timeout = false;
+    s->rx_timeout_ns = SIM_NO_EVENT;
+    s->hw.dr = SIM_DR_IDLE;
+    s->hw.rsr = 0;
+    sim_unlock();
+    return baudrate;
+}
+
+bool uart_is_readable(uart_inst_t *uart)
+{
+    sim_uart *s = sim_from_inst(uart);
+    sim_lock();
+    bool readable = s->rx_count > 0;
+    sim_unlock();
+    return readable;
+}
+
+bool uart_is_writable(uart_inst_t *uart)
+{
+    sim_uart *s = sim_from_inst(uart);
+    sim_lock();
+    sim_collect_tx(s);
+    bool writable = s->tx_count < SIM_UART_FIFO_DEPTH;
+    sim_unlock();
+    return writable;
+}
+
+char uart_getc(uart_inst_t *uart)
+{
+    sim_uart *s = sim_from_inst(uart);
+    uint8_t c = 0;
+    sim_lock();
+    if(s->rx_count > 0) {
+        c = s->rx_fifo[s->rx_rd];
+        s->rx_rd = (s->rx_rd + 1) % SIM_UART_FIFO_DEPTH;
+        --s->rx_count;
+        // receive timeout is cleared when the fifo is emptied
+        if(s->rx_count == 0) s->rx_timeout = false;
+    }
+    sim_unlock();
+    return (char) c;
+}
+
+void uart_set_irq_enables(uart_inst_t *uart, bool rx_has_data, bool tx_needs_data)
+{
+    sim_uart *s = sim_from_inst(uart);
+    sim_lock();
+    sim_collect_tx(s);
+    s->hw.imsc = ((uint32_t) tx_needs_data << UART_UARTIMSC_TXIM_LSB) |
+                 ((uint32_t) rx_has_data << UART_UARTIMSC_RXIM_LSB) |
+                 ((uint32_t) rx_has_data << UART_UARTIMSC_RTIM_LSB);
+    sim_unlock();
+}
+
+void irq_set_enabled(unsigned int num, bool enabled)
+{
+    sim_uart *s = sim_from_irq(num);
+    // each core has its own NVIC
+    s->nvic_enabled[get_core_num()] = enabled;
+    // pending interrupt is taken as soon as it is unmasked
+    if(enabled) sim_check_irq(s);
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past)
+{
+    (void) fire_if_past;
+    alarm_id_t id = -1;
+    sim_lock();
+    for(int i = 0; i < SIM_ALARMS; ++i) {
+        if(alarms[i].id) continue;
+        id = ++last_alarm_id;
+        alarms[i] = (sim_alarm) { .id = id, .at_ns = now_ns + us * 1000, .callback = callback, .user_data = user_data };
+        break;
+    }
+    sim_unlock();
+    return id;
+}
+
+bool cancel_alarm(alarm_id_t alarm_id)
+{
+    bool found = false;
+    sim_lock();
+    for(int i = 0; i < SIM_ALARMS; ++i) {
+        if(alarms[i].id == alarm_id) {
+            alarms[i].id = 0;
+            found = true;
+        }
+    }
+    sim_unlock();
+    return found;
+}
+
+void irq_set_exclusive_handler(unsigned int num, irq_handler_t handler)
+{
+    sim_from_irq(num)->handler = handler;
+}
+
+uint64_t time_us_64(void)
+{
+    return now_ns / 1000;
+}
+
+uint32_t time_us_32(void)
+{
+    return (uint32_t) time_us_64();
+}
+
+void sleep_us(uint64_t us)
+{
+    sim_advance_ns(us * 1000);
+}
+
+void sleep_ms(uint32_t ms)
+{
+    sleep_us((uint64_t) ms * 1000);
+}
+
+void tight_loop_contents(void)
+{
+    // busy loops make progress in simulated time
+    if(get_core_num() != 0) sched_yield();
+    else sim_advance_ns(1000);
+}
+
+void __sev(void)
+{
+    // event is signalled to both cores
+    event_flag[0] = true;
+    event_flag[1] = true;
+}
+
+void __wfe(void)
+{
+    // sleep until an event, simulation stops if nothing is going to happen
+    if(get_core_num() != 0) {
+        sim_core1_wait(UINT64_MAX, true);
+        return;
+    }
+    if(!event_flag[0]) sim_run(UINT64_MAX, true);
+    event_flag[0] = false;
+}
+
+bool best_effort_wfe_or_timeout(absolute_time_t timeout)
+{
+    uint64_t target = timeout * 1000;
+    if(target < now_ns) target = now_ns;
+    if(get_core_num() != 0) return !sim_core1_wait(target, true);
+    bool event = event_flag[0] || sim_run(target, true);
+    event_flag[0] = false;
+    return !event;
+}
@@ -0,0 +1,53 @@
+//
+// Simulated PL011 UART for running the uart_irq driver on a host.
+//
+// Each UART has 32 entry RX and TX fifos. Characters move at the configured
+// baud rate (10 bits per character) as the simulated clock advances. Interrupts
+// follow the settings that uart_set_irq_enables() programs on RP2040:
+// RX when the fifo holds 4 or more characters, RX timeout after 32 idle bit
+// periods and TX when the fifo has 4 or fewer characters left.
+// Handlers run to completion in zero simulated time, as do the callbacks of
+// alarms set with add_alarm_in_us().
+//
+
+#ifndef UART_IRQ_SIM_UART_H
+#define UART_IRQ_SIM_UART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SIM_UART_FIFO_DEPTH 32
+
+typedef struct {
+    uint32_t irq_count;     // handler invocations
+    uint32_t rx_bytes;      // characters that arrived from the wire
+    uint32_t fifo_overruns; // characters lost because RX fifo was full
+    uint32_t tx_bytes;      // characters sent to the wire
+    uint32_t core1_irqs;    // interrupts core 1 would have taken as well because its NVIC had them enabled
+} sim_uart_counters;
+
+typedef void (*sim_tx_sink_t)(int uart_nr, uint8_t c, void *ctx);
+
+// Resets simulated time and both UARTs
+void sim_reset(void);
+uint64_t sim_now_ns(void);
+void sim_advance_ns(uint64_t ns);
+
+// Starts sending data back to back to the UART's RX pin. Data is not copied.
+void sim_uart_start_rx(int uart_nr, const uint8_t *data, size_t size);
+bool sim_uart_rx_done(int uart_nr);
+bool sim_uart_tx_idle(int uart_nr);
+void sim_uart_set_tx_sink(int uart_nr, sim_tx_sink_t sink, void *ctx);
+void sim_uart_get_counters(int uart_nr, sim_uart_counters *counters);
+
+// Waits until the function started by multicore_launch_core1() returns.
+// Core 0 must keep the clock moving (sleep_us) while core 1 waits for time or events.
+bool sim_core1_done(void);
+void sim_core1_join(void);
+
+// True while the function started on core 1 is running. Core 1 code runs in zero
+// simulated time like the handlers: the clock only moves while core 1 sleeps or waits in __wfe().
+bool sim_core1_active(void);
+
+#endif //UART_IRQ_SIM_UART_H
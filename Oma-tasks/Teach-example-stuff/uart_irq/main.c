@@ -53,7 +53,6 @@ int main() {
     //const uint8_t send[] = "at\r\n";
     const char send[] = "at+VER\r\n";
     char str[STRLEN];
-    int pos = 0;
 
 #if 1
     for (int i = 0; i < 3; ++i) {
@@ -69,9 +68,8 @@ int main() {
             }
             uart_send(UART_NR, send);
         }
-        pos = uart_read(UART_NR, (uint8_t *) str, STRLEN);
-        if (pos > 0) {
-            str[pos] = '\0';
+        // sleep until a line arrives, wake up every 10 ms to check the button
+        if (uart_read_line(UART_NR, str, STRLEN, 10000) >= 0) {
             printf("%d, received: %s\n", time_us_32() / 1000, str);
         }
     }
@@ -1,56 +1,178 @@
 //
 // Created by keijo on 4.11.2023.
 //
-#include <stdlib.h>
+#include <string.h>
 #include "ring_buffer.h"
 
+// Memory ordering:
+// - producer fills the buffer and then publishes the new head with release semantics
+// - consumer loads head with acquire semantics before reading the data
+// - the same applies to tail in the other direction so that the producer
+//   never overwrites data that the consumer has not copied yet
+// Each side reads its own index relaxed because nobody else writes it.
+
+static uint32_t rb_round_down_pow2(uint32_t size)
+{
+    while(size & (size - 1)) {
+        size &= size - 1;
+    }
+    return size;
+}
 
 void rb_init(ring_buffer *rb, uint8_t *buffer, int size)
 {
-    rb->tail = 0;
-    rb->head = 0;
-    rb->size = size;
+    // size must be a power of two, round down so that we never go past the end of buffer
+    rb->size = rb_round_down_pow2((uint32_t) size);
+    rb->mask = rb->size - 1;
     rb->buffer = buffer;
+    atomic_store_explicit(&rb->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&rb->head, 0, memory_order_release);
 }
 
 bool rb_empty(ring_buffer *rb)
 {
-    return rb->head == rb->tail;
+    return rb_count(rb) == 0;
 }
 
 bool rb_full(ring_buffer *rb)
 {
-    return (rb->head + 1) % rb->size == rb->tail;
+    return rb_count(rb) == rb->size;
+}
+
+size_t rb_count(ring_buffer *rb)
+{
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    return head - tail;
+}
+
+size_t rb_space(ring_buffer *rb)
+{
+    return rb->size - rb_count(rb);
 }
 
 bool rb_put(ring_buffer *rb, uint8_t data)
 {
-    // calculate new head (position where to store the value)
-    int nh = (rb->head + 1) % rb->size;
-    // return false if buffer would be full
-    if(nh == rb->tail) return false;
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    // return false if buffer is full
+    if(head - tail == rb->size) return false;
 
-    rb->buffer[rb->head] = data;
-    rb->head = nh;
+    rb->buffer[head & rb->mask] = data;
+    atomic_store_explicit(&rb->head, head + 1, memory_order_release);
     return true;
 }
 
 uint8_t rb_get(ring_buffer *rb)
 {
-    uint8_t value = rb->buffer[rb->tail];
-    if(rb->head != rb->tail) {
-        rb->tail = (rb->tail + 1) % rb->size;
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    uint8_t value = rb->buffer[tail & rb->mask];
+    if(head != tail) {
+        atomic_store_explicit(&rb->tail, tail + 1, memory_order_release);
     }
     return value;
 }
 
-void rb_alloc(ring_buffer *rb, int size)
+size_t rb_write(ring_buffer *rb, const uint8_t *data, size_t size)
+{
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    size_t space = rb->size - (head - tail);
+    if(size > space) size = space;
+    if(size == 0) return 0;
+
+    // copy in at most two segments: up to the end of the buffer and then from the start
+    uint32_t pos = head & rb->mask;
+    size_t first = rb->size - pos;
+    if(first > size) first = size;
+    memcpy(rb->buffer + pos, data, first);
+    memcpy(rb->buffer, data + first, size - first);
+
+    atomic_store_explicit(&rb->head, head + (uint32_t) size, memory_order_release);
+    return size;
+}
+
+size_t rb_read(ring_buffer *rb, uint8_t *data, size_t size)
 {
-    uint8_t  *buffer = calloc(size, sizeof(uint8_t));
-    rb_init(rb, buffer, size);
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    size_t count = head - tail;
+    if(size > count) size = count;
+    if(size == 0) return 0;
+
+    uint32_t pos = tail & rb->mask;
+    size_t first = rb->size - pos;
+    if(first > size) first = size;
+    memcpy(data, rb->buffer + pos, first);
+    memcpy(data + first, rb->buffer, size - first);
+
+    atomic_store_explicit(&rb->tail, tail + (uint32_t) size, memory_order_release);
+    return size;
 }
 
-void rb_free(ring_buffer *rb)
+size_t rb_peek_contiguous(ring_buffer *rb, const uint8_t **data)
 {
-    free(rb->buffer);
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    uint32_t pos = tail & rb->mask;
+    size_t count = head - tail;
+    // span ends at the end of the buffer even if there is more data at the start
+    if(count > rb->size - pos) count = rb->size - pos;
+    *data = rb->buffer + pos;
+    return count;
+}
+
+void rb_consume(ring_buffer *rb, size_t count)
+{
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    atomic_store_explicit(&rb->tail, tail + (uint32_t) count, memory_order_release);
+}
+
+size_t rb_reserve_contiguous(ring_buffer *rb, uint8_t **data)
+{
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    uint32_t pos = head & rb->mask;
+    size_t space = rb->size - (head - tail);
+    if(space > rb->size - pos) space = rb->size - pos;
+    *data = rb->buffer + pos;
+    return space;
+}
+
+void rb_commit(ring_buffer *rb, size_t count)
+{
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    atomic_store_explicit(&rb->head, head + (uint32_t) count, memory_order_release);
+}
+
+// Searches for value starting from *offset bytes past the tail.
+// On return *offset is the index of the value or the number of bytes scanned,
+// so a later call continues where the previous one stopped.
+bool rb_find(ring_buffer *rb, size_t *offset, uint8_t value)
+{
+    uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    size_t count = head - tail;
+    size_t start = *offset;
+    if(start >= count) {
+        *offset = count;
+        return false;
+    }
+
+    uint32_t pos = (tail + start) & rb->mask;
+    size_t first = rb->size - pos;
+    if(first > count - start) first = count - start;
+    const uint8_t *p = memchr(rb->buffer + pos, value, first);
+    if(p != NULL) {
+        *offset = start + (p - (rb->buffer + pos));
+        return true;
+    }
+    p = memchr(rb->buffer, value, count - start - first);
+    if(p != NULL) {
+        *offset = start + first + (p - rb->buffer);
+        return true;
+    }
+    *offset = count;
+    return false;
 }
@@ -7,11 +7,18 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
 
+// Single producer / single consumer ring buffer.
+// Size is a power of two and head/tail are free running indices that are masked
+// when the buffer is accessed. Producer only writes head and consumer only writes tail
+// so the buffer can be shared between an ISR and a thread without disabling interrupts.
 typedef struct  {
-    int head;
-    int tail;
-    int size;
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    uint32_t size;
+    uint32_t mask;
     uint8_t *buffer;
 } ring_buffer;
 
@@ -21,7 +28,18 @@ bool rb_full(ring_buffer *rb);
 bool rb_put(ring_buffer *rb, uint8_t data);
 uint8_t rb_get(ring_buffer *rb);
 
-void rb_alloc(ring_buffer *rb, int size);
-void rb_free(ring_buffer *rb);
+size_t rb_count(ring_buffer *rb);
+size_t rb_space(ring_buffer *rb);
+size_t rb_write(ring_buffer *rb, const uint8_t *data, size_t size);
+size_t rb_read(ring_buffer *rb, uint8_t *data, size_t size);
+
+// zero-copy access: peek/reserve return the length of the contiguous span that
+// starts at the current tail/head. Data is released with consume/commit.
+size_t rb_peek_contiguous(ring_buffer *rb, const uint8_t **data);
+void rb_consume(ring_buffer *rb, size_t count);
+size_t rb_reserve_contiguous(ring_buffer *rb, uint8_t **data);
+void rb_commit(ring_buffer *rb, size_t count);
+
+bool rb_find(ring_buffer *rb, size_t *offset, uint8_t value);
 
 #endif //UART_IRQ_RING_BUFFER_H
@@ -2,18 +2,79 @@
 // Created by keijo on 4.11.2023.
 //
 #include <string.h>
+#include <stdatomic.h>
 #include "pico/stdlib.h"
 #include "hardware/uart.h"
+#include "hardware/sync.h"
 #include "ring_buffer.h"
 
 #include "uart.h"
 
+// Sizes of the statically allocated buffers used by uart_setup().
+// Sizes must be powers of two and can be set per UART from the build, for example
+// -DUART1_RX_BUFFER_SIZE=1024 -DUART1_TX_BUFFER_SIZE=128
+#ifndef UART_RX_BUFFER_SIZE
+#define UART_RX_BUFFER_SIZE 256
+#endif
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE 256
+#endif
+#ifndef UART0_RX_BUFFER_SIZE
+#define UART0_RX_BUFFER_SIZE UART_RX_BUFFER_SIZE
+#endif
+#ifndef UART0_TX_BUFFER_SIZE
+#define UART0_TX_BUFFER_SIZE UART_TX_BUFFER_SIZE
+#endif
+#ifndef UART1_RX_BUFFER_SIZE
+#define UART1_RX_BUFFER_SIZE UART_RX_BUFFER_SIZE
+#endif
+#ifndef UART1_TX_BUFFER_SIZE
+#define UART1_TX_BUFFER_SIZE UART_TX_BUFFER_SIZE
+#endif
+
+#define UART_IS_POW2(x) ((x) > 0 && ((x) & ((x) - 1)) == 0)
+_Static_assert(UART_IS_POW2(UART0_RX_BUFFER_SIZE) && UART_IS_POW2(UART0_TX_BUFFER_SIZE),
+               "UART0 buffer sizes must be powers of two");
+_Static_assert(UART_IS_POW2(UART1_RX_BUFFER_SIZE) && UART_IS_POW2(UART1_TX_BUFFER_SIZE),
+               "UART1 buffer sizes must be powers of two");
+
+// Each core writes to its own transmit buffer so that both cores can queue data without locking.
+// Statistics are kept per core for the same reason and combined by uart_get_stats().
+typedef struct {
+    ring_buffer buffer;
+    uint32_t bytes;
+    uint32_t short_writes;
+    uint32_t high_water;
+} uart_tx_stage;
+
 typedef struct {
-    ring_buffer tx;
+    uart_tx_stage tx[2];
     ring_buffer rx;
     uart_inst_t *uart;
     int irqn;
     irq_handler_t handler;
+    // transmit ISR takes data from one core's buffer at a time: when it switches to a buffer it
+    // takes only what was queued at that moment so that messages from the two cores are not mixed
+    int tx_src;
+    size_t tx_budget;
+    // held while the fifo is filled, either by the ISR or by a writer starting an idle transmitter,
+    // and while stats are updated. The NVIC is per core, so masking the interrupt does not keep
+    // the ISR out when the caller runs on the other core.
+    spin_lock_t *tx_lock;
+    size_t line_scan; // number of received bytes already searched for line end
+    uart_stats stats;
+    // event counters are written only by the ISR, reader compares them to the values it has seen
+    volatile uint32_t rx_data_seq;
+    volatile uint32_t rx_idle_seq;
+    uint32_t rx_data_seen;
+    uint32_t rx_idle_seen;
+    uart_event_callback event_callback;
+    // Receive timeout interrupt fires only when characters are left in the fifo, so a message that ends
+    // when the ISR has just emptied the fifo needs a timer to detect the idle line. Protected by tx_lock.
+    uint32_t idle_us;       // 32 bit periods
+    uint64_t last_rx_us;    // when the ISR last took characters from the fifo
+    bool idle_armed;        // idle has not been reported since the last characters
+    alarm_id_t idle_alarm;  // 0 if no alarm is scheduled
 } uart_t;
 
 void uart_irq_rx(uart_t *u);
@@ -26,24 +87,58 @@ static uart_t *uart_get_handle(int uart_nr);
 static uart_t u0 = { .uart = uart0, .irqn = UART0_IRQ, .handler = uart0_handler };
 static uart_t u1 = { .uart = uart1, .irqn = UART1_IRQ, .handler = uart1_handler };
 
+static uint8_t u0_rx_buffer[UART0_RX_BUFFER_SIZE];
+static uint8_t u0_tx_buffer[UART0_TX_BUFFER_SIZE];
+static uint8_t u1_rx_buffer[UART1_RX_BUFFER_SIZE];
+static uint8_t u1_tx_buffer[UART1_TX_BUFFER_SIZE];
+
 static uart_t *uart_get_handle(int uart_nr) {
     return uart_nr ? &u1 : &u0;
 }
 
 
 void uart_setup(int uart_nr, int tx_pin, int rx_pin, int speed)
+{
+    if(uart_nr) {
+        uart_setup_buffers(uart_nr, tx_pin, rx_pin, speed,
+                           u1_rx_buffer, sizeof(u1_rx_buffer), u1_tx_buffer, sizeof(u1_tx_buffer));
+    }
+    else {
+        uart_setup_buffers(uart_nr, tx_pin, rx_pin, speed,
+                           u0_rx_buffer, sizeof(u0_rx_buffer), u0_tx_buffer, sizeof(u0_tx_buffer));
+    }
+}
+
+void uart_setup_buffers(int uart_nr, int tx_pin, int rx_pin, int speed,
+                        uint8_t *rx_buffer, int rx_size, uint8_t *tx_buffer, int tx_size)
 {
     uart_t *uart = uart_get_handle(uart_nr);
 
     // ensure that we don't get any interrupts from the uart during configuration
     irq_set_enabled(uart->irqn, false);
 
-    // allocate space for ring buffers
-    rb_alloc(&uart->rx, 256);
-    rb_alloc(&uart->tx, 256);
+    // ring buffers use the memory given by the caller, core 1 has no transmit buffer until one is set
+    rb_init(&uart->rx, rx_buffer, rx_size);
+    for(int i = 0; i < 2; ++i) {
+        rb_init(&uart->tx[i].buffer, i ? NULL : tx_buffer, i ? 0 : tx_size);
+        uart->tx[i].bytes = uart->tx[i].short_writes = uart->tx[i].high_water = 0;
+    }
+    uart->tx_src = 0;
+    uart->tx_budget = 0;
+    if(uart->tx_lock == NULL) {
+        uart->tx_lock = spin_lock_instance(spin_lock_claim_unused(true));
+    }
+    uart->line_scan = 0;
+    memset(&uart->stats, 0, sizeof(uart->stats));
+    uart->rx_data_seen = uart->rx_data_seq;
+    uart->rx_idle_seen = uart->rx_idle_seq;
+    uart->idle_armed = false;
+    if(uart->idle_alarm > 0) cancel_alarm(uart->idle_alarm);
+    uart->idle_alarm = 0;
 
     // Set up our UART with the required speed.
-    uart_init(uart->uart, speed);
+    unsigned int baud = uart_init(uart->uart, speed);
+    uart->idle_us = (32 * 1000000 + baud - 1) / baud;
 
     // Set the TX and RX pins by using the function select on the GPIO
     // See datasheet for more information on function select
@@ -58,68 +153,458 @@ void uart_setup(int uart_nr, int tx_pin, int rx_pin, int speed)
     irq_set_enabled(uart->irqn, true);
 }
 
+void uart_set_core1_tx_buffer(int uart_nr, uint8_t *buffer, int size)
+{
+    uart_t *u = uart_get_handle(uart_nr);
+    uint32_t save = spin_lock_blocking(u->tx_lock);
+    rb_init(&u->tx[1].buffer, buffer, size);
+    if(u->tx_src == 1) u->tx_budget = 0;
+    spin_unlock(u->tx_lock, save);
+}
+
 int uart_read(int uart_nr, uint8_t *buffer, int size)
 {
-    int count = 0;
     uart_t *u = uart_get_handle(uart_nr);
-    while(count < size && !rb_empty(&u->rx)) {
-        *buffer++ = rb_get(&u->rx);
-        ++count;
+    u->line_scan = 0;
+    return (int) rb_read(&u->rx, buffer, size);
+}
+
+// Copies count bytes from receive buffer to str, what does not fit is left for the next call.
+// If they end a line, the line end is stripped.
+static int uart_take_line(uart_t *u, char *str, int size, size_t count, bool line_end)
+{
+    size_t len = count < (size_t) size - 1 ? count : (size_t) size - 1;
+    size_t rest = count - len;
+    rb_read(&u->rx, (uint8_t *) str, len);
+    // a line end that did not fit is consumed too, so that it doesn't come out as an empty line
+    const uint8_t *next;
+    if(line_end && (rest == 1 || (rest == 2 && rb_peek_contiguous(&u->rx, &next) > 0 && next[0] == '\r'))) {
+        rb_consume(&u->rx, rest);
+        rest = 0;
     }
-    return count;
+    u->line_scan = u->line_scan > count - rest ? u->line_scan - (count - rest) : 0;
+
+    if(line_end && rest == 0) {
+        if(len > 0 && str[len - 1] == '\n') --len;
+        if(len > 0 && str[len - 1] == '\r') --len;
+    }
+    str[len] = '\0';
+    return (int) len;
 }
 
-int uart_write(int uart_nr, const uint8_t *buffer, int size)
+int uart_read_line(int uart_nr, char *str, int size, uint32_t timeout_us)
+{
+    if(size < 2) return -1;
+    uart_t *u = uart_get_handle(uart_nr);
+    absolute_time_t deadline = make_timeout_time_us(timeout_us);
+    bool timeout = false;
+    for(;;) {
+        // scan only the bytes that have arrived since the previous call
+        if(rb_find(&u->rx, &u->line_scan, '\n')) {
+            return uart_take_line(u, str, size, u->line_scan + 1, true);
+        }
+        // line does not fit in the caller's buffer, return the next piece of it
+        if(u->line_scan >= (size_t) size - 1) {
+            return uart_take_line(u, str, size, size - 1, false);
+        }
+        if(timeout) return -1;
+        // receive interrupt wakes us up when more data arrives
+        timeout = best_effort_wfe_or_timeout(deadline);
+    }
+}
+
+uint32_t uart_get_events(int uart_nr)
+{
+    uart_t *u = uart_get_handle(uart_nr);
+    uint32_t events = 0;
+    uint32_t seq = u->rx_data_seq;
+    if(seq != u->rx_data_seen) {
+        u->rx_data_seen = seq;
+        events |= UART_EVENT_RX_DATA;
+    }
+    seq = u->rx_idle_seq;
+    if(seq != u->rx_idle_seen) {
+        u->rx_idle_seen = seq;
+        events |= UART_EVENT_RX_IDLE;
+    }
+    return events;
+}
+
+uint32_t uart_wait_events(int uart_nr, uint32_t mask, uint32_t timeout_us)
+{
+    absolute_time_t deadline = make_timeout_time_us(timeout_us);
+    uint32_t events;
+    // ISR executes __sev() after updating the counters, event is latched until the next wfe
+    while(!(events = uart_get_events(uart_nr) & mask)) {
+        if(best_effort_wfe_or_timeout(deadline)) {
+            return uart_get_events(uart_nr) & mask;
+        }
+    }
+    return events;
+}
+
+void uart_set_event_callback(int uart_nr, uart_event_callback callback)
+{
+    uart_t *u = uart_get_handle(uart_nr);
+    // ISR reads the pointer once, the lock orders the write against a handler running on the other core
+    uint32_t save = spin_lock_blocking(u->tx_lock);
+    u->event_callback = callback;
+    spin_unlock(u->tx_lock, save);
+}
+
+int uart_peek(int uart_nr, const uint8_t **data)
+{
+    uart_t *u = uart_get_handle(uart_nr);
+    return (int) rb_peek_contiguous(&u->rx, data);
+}
+
+void uart_consume(int uart_nr, int count)
 {
-    int count = 0;
     uart_t *u = uart_get_handle(uart_nr);
-    // write data to ring buffer
-    while(count < size && !rb_full(&u->tx)) {
-        rb_put(&u->tx, *buffer++);
-        ++count;
+    u->line_scan = 0;
+    rb_consume(&u->rx, count);
+}
+
+// Transmit buffer of the calling core
+static uart_tx_stage *uart_tx_get(uart_t *u)
+{
+    return &u->tx[get_core_num()];
+}
+
+// Copies data to transmit buffer without starting transmission
+static int uart_tx_queue(uart_tx_stage *t, const uint8_t *buffer, int size)
+{
+    // the whole block is published at once so the ISR never sees a part of it
+    int count = (int) rb_write(&t->buffer, buffer, size);
+
+    // transmit statistics are only modified by the writing core so no locking is needed
+    t->bytes += count;
+    uint32_t used = rb_count(&t->buffer);
+    if(used > t->high_water) t->high_water = used;
+
+    return count;
+}
+
+static bool uart_tx_empty(uart_t *u)
+{
+    return rb_empty(&u->tx[0].buffer) && rb_empty(&u->tx[1].buffer);
+}
+
+// Moves data from the transmit buffers to the fifo. Caller must hold tx_lock.
+static void uart_tx_fill(uart_t *u)
+{
+    bool consumed = false;
+    while(uart_is_writable(u->uart)) {
+        if(u->tx_budget == 0) {
+            // previous batch has been sent, prefer the other core so that neither can starve the other
+            int src = u->tx_src ^ 1;
+            size_t count = rb_count(&u->tx[src].buffer);
+            if(count == 0) {
+                src = u->tx_src;
+                count = rb_count(&u->tx[src].buffer);
+            }
+            if(count == 0) break;
+            u->tx_src = src;
+            u->tx_budget = count;
+        }
+        ring_buffer *rb = &u->tx[u->tx_src].buffer;
+        const uint8_t *span;
+        size_t size = rb_peek_contiguous(rb, &span);
+        if(size > u->tx_budget) size = u->tx_budget;
+        size_t count = 0;
+        while(count < size && uart_is_writable(u->uart)) {
+            uart_get_hw(u->uart)->dr = span[count++];
+        }
+        rb_consume(rb, count);
+        u->tx_budget -= count;
+        consumed = true;
     }
-    // disable interrupts on NVIC while managing transmit interrupts
-    irq_set_enabled(u->irqn, false);
+    // wake up writers waiting for space
+    if(consumed) __sev();
+}
 
+// Starts transmission of buffered data if transmitter is idle
+static void uart_tx_kick(uart_t *u)
+{
+    // Queued data must be visible before the interrupt enable is read. Pairs with the fence in
+    // uart_irq_tx(): either we see the transmit interrupt disabled or the ISR sees our data.
+    atomic_thread_fence(memory_order_seq_cst);
+    // transmitter is running, the ISR picks up the data
+    if(uart_get_hw(u->uart)->imsc & (1 << UART_UARTIMSC_TXIM_LSB)) return;
+
+    // Spin lock instead of masking the interrupt on NVIC: the ISR may run on the other core
+    uint32_t save = spin_lock_blocking(u->tx_lock);
     // if transmit interrupt is not enabled we need to enable it and give fifo an initial filling
     if(!(uart_get_hw(u->uart)->imsc & (1 << UART_UARTIMSC_TXIM_LSB))) {
-        // enable transmit interrupt
         uart_set_irq_enables(u->uart, true, true);
-        // fifo requires initial filling
-        uart_irq_tx(u);
+        uart_tx_fill(u);
+    }
+    spin_unlock(u->tx_lock, save);
+}
+
+int uart_write(int uart_nr, const uint8_t *buffer, int size)
+{
+    uart_t *u = uart_get_handle(uart_nr);
+    uart_tx_stage *t = uart_tx_get(u);
+    int count = uart_tx_queue(t, buffer, size);
+    if(count < size) ++t->short_writes;
+    uart_tx_kick(u);
+    return count;
+}
+
+// Queues data and sleeps until transmit interrupt frees space for the rest.
+// Waits forever if forever is true, otherwise until the timeout expires.
+static int uart_tx_queue_wait(uart_t *u, const uint8_t *buffer, int size, bool forever, absolute_time_t timeout)
+{
+    uart_tx_stage *t = uart_tx_get(u);
+    // core 1 without a buffer would wait forever for space
+    if(t->buffer.size == 0 && size > 0) {
+        ++t->short_writes;
+        return -1;
     }
+    int count = 0;
+    for(;;) {
+        count += uart_tx_queue(t, buffer + count, size - count);
+        // transmitter must be running so that the ISR frees space and signals us
+        uart_tx_kick(u);
+        if(count == size) break;
+        // ISR executes __sev() after it has taken data from the buffer. Event is latched
+        // so a wakeup that happens between the space check and wfe is not lost.
+        if(forever) {
+            __wfe();
+        }
+        else if(best_effort_wfe_or_timeout(timeout)) {
+            // last attempt after timeout
+            count += uart_tx_queue(t, buffer + count, size - count);
+            uart_tx_kick(u);
+            break;
+        }
+    }
+    if(count < size) ++t->short_writes;
+    return count;
+}
 
-    // enable interrupts on NVIC
-    irq_set_enabled(u->irqn, true);
+int uart_write_all(int uart_nr, const uint8_t *buffer, int size)
+{
+    uart_t *u = uart_get_handle(uart_nr);
+    return uart_tx_queue_wait(u, buffer, size, true, nil_time);
+}
+
+int uart_write_timeout(int uart_nr, const uint8_t *buffer, int size, uint32_t timeout_us)
+{
+    uart_t *u = uart_get_handle(uart_nr);
+    return uart_tx_queue_wait(u, buffer, size, false, make_timeout_time_us(timeout_us));
+}
+
+int uart_write_atomic(int uart_nr, const uint8_t *buffer, int size)
+{
+    uart_t *u = uart_get_handle(uart_nr);
+    uart_tx_stage *t = uart_tx_get(u);
+    // only this core adds data to its buffer, so the space can only grow after the check
+    if(rb_space(&t->buffer) < (size_t) size) {
+        ++t->short_writes;
+        return 0;
+    }
+    uart_tx_queue(t, buffer, size);
+    uart_tx_kick(u);
+    return size;
+}
 
+int uart_queue(int uart_nr, const uint8_t *buffer, int size)
+{
+    uart_tx_stage *t = uart_tx_get(uart_get_handle(uart_nr));
+    int count = uart_tx_queue(t, buffer, size);
+    if(count < size) ++t->short_writes;
     return count;
 }
 
+int uart_writev(int uart_nr, const uart_iovec *iov, int iovcnt)
+{
+    uart_t *u = uart_get_handle(uart_nr);
+    uart_tx_stage *t = uart_tx_get(u);
+    int total = 0;
+    for(int i = 0; i < iovcnt; ++i) {
+        int count = uart_tx_queue(t, iov[i].iov_base, (int) iov[i].iov_len);
+        total += count;
+        // stop at the first fragment that did not fit so that data is not interleaved
+        if(count < (int) iov[i].iov_len) {
+            ++t->short_writes;
+            break;
+        }
+    }
+    uart_tx_kick(u);
+    return total;
+}
+
+void uart_flush(int uart_nr)
+{
+    uart_tx_kick(uart_get_handle(uart_nr));
+}
+
 int uart_send(int uart_nr, const char *str)
 {
-    return uart_write(uart_nr, (const uint8_t *)str, strlen(str));
+    return uart_write_all(uart_nr, (const uint8_t *)str, strlen(str));
+}
+
+void uart_get_stats(int uart_nr, uart_stats *stats)
+{
+    uart_t *u = uart_get_handle(uart_nr);
+    // take a consistent snapshot, the ISR updates the counters under the same lock
+    uint32_t save = spin_lock_blocking(u->tx_lock);
+    *stats = u->stats;
+    spin_unlock(u->tx_lock, save);
+    // transmit counters are written by the cores that queue data
+    for(int i = 0; i < 2; ++i) {
+        stats->tx_bytes += u->tx[i].bytes;
+        stats->tx_short_writes += u->tx[i].short_writes;
+        if(u->tx[i].high_water > stats->tx_high_water) stats->tx_high_water = u->tx[i].high_water;
+    }
+}
+
+void uart_reset_stats(int uart_nr)
+{
+    uart_t *u = uart_get_handle(uart_nr);
+    uint32_t save = spin_lock_blocking(u->tx_lock);
+    memset(&u->stats, 0, sizeof(u->stats));
+    spin_unlock(u->tx_lock, save);
+    for(int i = 0; i < 2; ++i) {
+        u->tx[i].bytes = u->tx[i].short_writes = u->tx[i].high_water = 0;
+    }
 }
 
 
+static void uart_report_events(uart_t *u, uint32_t events)
+{
+    uart_event_callback callback = u->event_callback;
+    if(callback) callback(u == &u1 ? 1 : 0, events);
+    // wake up a reader sleeping in wfe
+    __sev();
+}
+
+// Reports idle line when no characters have been taken for 32 bit periods. Runs in the timer interrupt.
+static int64_t uart_idle_alarm(alarm_id_t id, void *user_data)
+{
+    (void) id;
+    uart_t *u = user_data;
+    uint32_t save = spin_lock_blocking(u->tx_lock);
+    int64_t again = 0;
+    bool idle = false;
+    if(u->idle_armed && !uart_is_readable(u->uart)) {
+        uint64_t elapsed = time_us_64() - u->last_rx_us;
+        if(elapsed < u->idle_us) {
+            // more characters arrived after the alarm was set
+            again = (int64_t) (u->idle_us - elapsed);
+        }
+        else {
+            idle = true;
+            u->idle_armed = false;
+            ++u->rx_idle_seq;
+        }
+    }
+    // characters waiting in the fifo are followed by the receive timeout interrupt which reports idle
+    else {
+        u->idle_armed = false;
+    }
+    if(again == 0) u->idle_alarm = 0;
+    spin_unlock(u->tx_lock, save);
+
+    if(idle) uart_report_events(u, UART_EVENT_RX_IDLE);
+    return again;
+}
+
 void uart_irq_rx(uart_t *u)
 {
+    uint8_t *span;
+    size_t space = 0;
+    size_t count = 0;
+    uint32_t received = 0;
+    uint32_t stored = 0;
+    uint32_t overruns = 0, breaks = 0, framing = 0;
+    // receive timeout means that the line has been idle for 32 bit periods
+    bool idle = uart_get_hw(u->uart)->mis & UART_UARTMIS_RTMIS_BITS;
     while(uart_is_readable(u->uart)) {
         uint8_t c = uart_getc(u->uart);
-        // ignoring return value for now
-        rb_put(&u->rx, c);
+        ++received;
+        // error status of the character is available in RSR after the character has been read from DR
+        uint32_t rsr = uart_get_hw(u->uart)->rsr;
+        if(rsr) {
+            if(rsr & UART_UARTRSR_OE_BITS) ++overruns;
+            if(rsr & UART_UARTRSR_BE_BITS) ++breaks;
+            if(rsr & UART_UARTRSR_FE_BITS) ++framing;
+            // writing any value clears the error flags
+            uart_get_hw(u->uart)->rsr = 0;
+        }
+        if(count == space) {
+            // current span is full, publish it and continue from the start of the buffer
+            rb_commit(&u->rx, count);
+            stored += count;
+            count = 0;
+            space = rb_reserve_contiguous(&u->rx, &span);
+        }
+        // characters are dropped when the buffer is full
+        if(count < space) {
+            span[count++] = c;
+        }
     }
+    rb_commit(&u->rx, count);
+    stored += count;
+
+    uint32_t save = spin_lock_blocking(u->tx_lock);
+    ++u->stats.irq_count;
+    u->stats.overrun_errors += overruns;
+    u->stats.break_errors += breaks;
+    u->stats.framing_errors += framing;
+    u->stats.rx_bytes += stored;
+    u->stats.rx_dropped += received - stored;
+    uint32_t used = rb_count(&u->rx);
+    if(used > u->stats.rx_high_water) u->stats.rx_high_water = used;
+
+    uint32_t events = 0;
+    if(stored > 0) {
+        ++u->rx_data_seq;
+        events |= UART_EVENT_RX_DATA;
+    }
+    if(idle) {
+        // line has already been idle for 32 bit periods, a pending alarm finds nothing to do
+        u->idle_armed = false;
+        ++u->rx_idle_seq;
+        events |= UART_EVENT_RX_IDLE;
+    }
+    else if(received > 0) {
+        // fifo was emptied at the watermark, the alarm checks if anything follows
+        u->last_rx_us = time_us_64();
+        u->idle_armed = true;
+        if(u->idle_alarm == 0) {
+            // not fire_if_past: the callback takes tx_lock which is held here
+            alarm_id_t id = add_alarm_in_us(u->idle_us, uart_idle_alarm, u, false);
+            // without an alarm only the receive timeout interrupt reports idle
+            if(id > 0) u->idle_alarm = id;
+            else u->idle_armed = false;
+        }
+    }
+    spin_unlock(u->tx_lock, save);
+
+    if(events) uart_report_events(u, events);
 }
 
 void uart_irq_tx(uart_t *u)
 {
-    while(!rb_empty(&u->tx) && uart_is_writable(u->uart)) {
-        uart_get_hw(u->uart)->dr = rb_get((&u->tx));
-    }
+    // nothing to do if transmitter is idle, a writer starts it under the lock
+    if(!(uart_get_hw(u->uart)->imsc & (1 << UART_UARTIMSC_TXIM_LSB))) return;
 
-    if (rb_empty(&u->tx)) {
-        // disable tx interrupt if transmit buffer is empty
+    uint32_t save = spin_lock_blocking(u->tx_lock);
+    uart_tx_fill(u);
+    if(uart_tx_empty(u)) {
+        // disable tx interrupt if transmit buffers are empty
         uart_set_irq_enables(u->uart, true, false);
+        // a writer may have queued data after the check above but seen the interrupt still enabled
+        atomic_thread_fence(memory_order_seq_cst);
+        if(!uart_tx_empty(u)) {
+            uart_set_irq_enables(u->uart, true, true);
+            uart_tx_fill(u);
+        }
     }
+    spin_unlock(u->tx_lock, save);
 }
 
 void uart0_handler(void)
@@ -5,10 +5,81 @@
 #ifndef UART_IRQ_UART_H
 #define UART_IRQ_UART_H
 
+#include <stdint.h>
+#include <stddef.h>
 
+typedef struct {
+    uint32_t rx_bytes;          // bytes stored to receive buffer
+    uint32_t rx_dropped;        // bytes lost because receive buffer was full
+    uint32_t tx_bytes;          // bytes accepted to transmit buffer
+    uint32_t tx_short_writes;   // writes that did not fit completely to transmit buffer
+    uint32_t irq_count;         // number of interrupt handler invocations
+    uint32_t overrun_errors;    // hardware fifo overruns (characters lost before ISR ran)
+    uint32_t framing_errors;
+    uint32_t break_errors;
+    uint32_t rx_high_water;     // maximum number of bytes in receive buffer
+    uint32_t tx_high_water;     // maximum number of bytes in transmit buffer
+} uart_stats;
+
+// Receive events
+#define UART_EVENT_RX_DATA 0x01 // new data stored to receive buffer
+#define UART_EVENT_RX_IDLE 0x02 // receiver has been idle for 32 bit periods after receiving data,
+                                // uses the receive timeout interrupt and an alarm from the default alarm pool
+
+// Called from the UART interrupt handler
+typedef void (*uart_event_callback)(int uart_nr, uint32_t events);
+
+// Same layout as POSIX struct iovec which is not available in newlib
+typedef struct {
+    const void *iov_base;
+    size_t iov_len;
+} uart_iovec;
+
+// Sets up the UART with statically allocated buffers, see UART_RX_BUFFER_SIZE and UART_TX_BUFFER_SIZE in uart.c
+// The interrupt is enabled on the NVIC of the calling core and the handler runs there. The other
+// functions may be called from either core.
 void uart_setup(int uart_nr, int tx_pin, int rx_pin, int speed);
+// Sets up the UART with buffers provided by the caller. Buffers must stay valid while the UART is in use
+// and their sizes should be powers of two (a size that is not is rounded down).
+void uart_setup_buffers(int uart_nr, int tx_pin, int rx_pin, int speed,
+                        uint8_t *rx_buffer, int rx_size, uint8_t *tx_buffer, int tx_size);
+// Gives core 1 its own transmit buffer so that both cores can write to the UART. Call after setup and
+// before core 1 writes. Without it writes from core 1 queue nothing and the blocking writes
+// (uart_write_all, uart_write_timeout, uart_send) return -1. Each core's data stays in order
+// and a block queued with one call is sent without data from the other core in the middle.
+void uart_set_core1_tx_buffer(int uart_nr, uint8_t *buffer, int size);
 int uart_read(int uart_nr, uint8_t *buffer, int size);
+// Reads one line terminated by '\n'. Line end is stripped and str is always null terminated.
+// A line longer than size - 1 characters is returned in pieces of size - 1 characters, whether
+// its end has arrived or not. Returns length of the line or piece, or -1 if size is less than 2
+// or no complete line was received within timeout_us. Sleeps between received characters.
+int uart_read_line(int uart_nr, char *str, int size, uint32_t timeout_us);
+// Returns events that have happened since the previous call
+uint32_t uart_get_events(int uart_nr);
+// Sleeps (wfe) until one of the events in mask happens or timeout expires.
+// Returns the events that happened or 0 on timeout.
+uint32_t uart_wait_events(int uart_nr, uint32_t mask, uint32_t timeout_us);
+void uart_set_event_callback(int uart_nr, uart_event_callback callback);
+int uart_peek(int uart_nr, const uint8_t **data);
+void uart_consume(int uart_nr, int count);
+// Queues as much as fits to transmit buffer and returns the number of bytes queued
 int uart_write(int uart_nr, const uint8_t *buffer, int size);
+// Sleeps (wfe) until all data has been queued
+int uart_write_all(int uart_nr, const uint8_t *buffer, int size);
+// Sleeps until all data has been queued or timeout expires, returns the number of bytes queued
+int uart_write_timeout(int uart_nr, const uint8_t *buffer, int size, uint32_t timeout_us);
+// Queues all data or nothing, returns size or 0
+int uart_write_atomic(int uart_nr, const uint8_t *buffer, int size);
+// Writes a null terminated string, blocks until the whole string has been queued
 int uart_send(int uart_nr, const char *str);
+// Queues data without starting transmission, call uart_flush() to start sending
+int uart_queue(int uart_nr, const uint8_t *buffer, int size);
+// Queues all fragments and starts transmission once. Returns number of bytes queued,
+// fragments after the first one that does not fit are not queued.
+int uart_writev(int uart_nr, const uart_iovec *iov, int iovcnt);
+// Starts transmission of queued data, does not wait for it to complete
+void uart_flush(int uart_nr);
+void uart_get_stats(int uart_nr, uart_stats *stats);
+void uart_reset_stats(int uart_nr);
 
 #endif //UART_IRQ_UART_H